@@ -48,6 +48,10 @@
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
 
+/* Most sectors we transfer with one command.  The sector count
+   register holds 8 bits. */
+#define SECTOR_RUN_MAX 255
+
 /* An ATA device. */
 struct disk {
 	char name[8];               /* Name, e.g. "hd0:1". */
@@ -84,7 +88,7 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -216,7 +220,7 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
+	select_sector (d, sec_no, 1);
 	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
 	sema_down (&c->completion_wait);
 	if (!wait_while_busy (d))
@@ -226,6 +230,48 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 	lock_release (&c->lock);
 }
 
+/* Reads the CNT sectors starting at SEC_NO from disk D into
+   BUFFER, which must have room for CNT * DISK_SECTOR_SIZE bytes.
+   Up to SECTOR_RUN_MAX sectors are read with a single command,
+   so a run costs one seek and one command instead of one of
+   each per sector.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, void *buffer,
+		size_t cnt) {
+	struct channel *c;
+	uint8_t *p = buffer;
+
+	ASSERT (d != NULL);
+	ASSERT (buffer != NULL);
+
+	c = d->channel;
+	while (cnt > 0) {
+		size_t run = cnt < SECTOR_RUN_MAX ? cnt : SECTOR_RUN_MAX;
+		size_t i;
+
+		lock_acquire (&c->lock);
+		select_sector (d, sec_no, run);
+		issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+		for (i = 0; i < run; i++) {
+			/* The disk interrupts once for each sector it has
+			   ready. */
+			sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name,
+						sec_no + (disk_sector_t) i);
+			input_sector (c, p);
+			p += DISK_SECTOR_SIZE;
+		}
+		d->read_cnt += run;
+		lock_release (&c->lock);
+
+		sec_no += run;
+		cnt -= run;
+	}
+}
+
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
    DISK_SECTOR_SIZE bytes.  Returns after the disk has
    acknowledged receiving the data.
@@ -240,7 +286,7 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 
 	c = d->channel;
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
+	select_sector (d, sec_no, 1);
 	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
 	if (!wait_while_busy (d))
 		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
@@ -250,6 +296,48 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 	lock_release (&c->lock);
 }
 
+/* Writes the CNT sectors starting at SEC_NO on disk D from
+   BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.  Up to
+   SECTOR_RUN_MAX sectors are written with a single command, as in
+   disk_read_multiple().  Returns after the disk has acknowledged
+   receiving all the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no,
+		const void *buffer, size_t cnt) {
+	struct channel *c;
+	const uint8_t *p = buffer;
+
+	ASSERT (d != NULL);
+	ASSERT (buffer != NULL);
+
+	c = d->channel;
+	while (cnt > 0) {
+		size_t run = cnt < SECTOR_RUN_MAX ? cnt : SECTOR_RUN_MAX;
+		size_t i;
+
+		lock_acquire (&c->lock);
+		select_sector (d, sec_no, run);
+		issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+		for (i = 0; i < run; i++) {
+			/* The disk asks for each sector in turn, and interrupts
+			   once it has taken it. */
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name,
+						sec_no + (disk_sector_t) i);
+			output_sector (c, p);
+			sema_down (&c->completion_wait);
+			p += DISK_SECTOR_SIZE;
+		}
+		d->write_cnt += run;
+		lock_release (&c->lock);
+
+		sec_no += run;
+		cnt -= run;
+	}
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -402,17 +490,18 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT, the number of sectors to transfer, to
+   the disk's sector selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
 	ASSERT (sec_no < d->capacity);
+	ASSERT (cnt > 0 && cnt <= SECTOR_RUN_MAX && cnt <= d->capacity - sec_no);
 	ASSERT (sec_no < (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -532,13 +621,13 @@ interrupt_handler (struct intr_frame *f) {
 static void
 inspect_read_cnt (struct intr_frame *f) {
 	struct disk * d = disk_get (f->R.rdx, f->R.rcx);
-	f->R.rax = d->read_cnt;
+	f->R.rax = d != NULL ? (uint64_t) d->read_cnt : (uint64_t) -1;
 }
 
 static void
 inspect_write_cnt (struct intr_frame *f) {
 	struct disk * d = disk_get (f->R.rdx, f->R.rcx);
-	f->R.rax = d->write_cnt;
+	f->R.rax = d != NULL ? (uint64_t) d->write_cnt : (uint64_t) -1;
 }
 
 /* Tool for testing disk r/w cnt. Calling this function via int 0x43 and int 0x44.
@@ -546,7 +635,7 @@ inspect_write_cnt (struct intr_frame *f) {
  *   @RDX - chan_no of disk to inspect
  *   @RCX - dev_no of disk to inspect
  * Output:
- *   @RAX - Read/Write count of disk. */
+ *   @RAX - Read/Write count of disk, or -1 if there is no such disk. */
 void
 register_disk_inspect_intr (void) {
 	intr_register_int (0x43, 3, INTR_OFF, inspect_read_cnt, "Inspect Disk Read Count");
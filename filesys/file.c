@@ -2,6 +2,9 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#ifdef VM
+#include "vm/userfault.h"
+#endif
 
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
@@ -36,6 +39,17 @@ file_reopen (struct file *file) {
  * same inode as FILE. Returns a null pointer if unsuccessful. */
 struct file *
 file_duplicate (struct file *file) {
+#ifdef VM
+	/* Userfault */
+	if (file->uffd != NULL) {
+		struct file *nfile = file_open_userfault (userfault_reopen (file->uffd));
+
+		if (nfile == NULL) {
+			userfault_close (file->uffd);
+		}
+		return nfile;
+	}
+#endif
 	struct file *nfile = file_open (inode_reopen (file->inode));
 	if (nfile) {
 		nfile->pos = file->pos;
@@ -47,10 +61,29 @@ file_duplicate (struct file *file) {
 	return nfile;
 }
 
+/* Userfault */
+/* Returns a new file through which UFFD, whose reference it takes
+ * over, is handled.  Returns a null pointer if memory runs out. */
+struct file *
+file_open_userfault (struct userfault *uffd) {
+	struct file *file = calloc (1, sizeof *file);
+
+	if (file != NULL) {
+		file->uffd = uffd;
+	}
+	return file;
+}
+
 /* Closes FILE. */
 void
 file_close (struct file *file) {
 	if (file != NULL) {
+#ifdef VM
+		/* Userfault */
+		if (file->uffd != NULL) {
+			userfault_close (file->uffd);
+		}
+#endif
 		file_allow_write (file);
 		inode_close (file->inode);
 		free (file);
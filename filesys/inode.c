@@ -201,8 +201,15 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 			break;
 
 		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
+			/* Read full sectors directly into caller's buffer.  A
+			 * file's sectors are contiguous on disk, so a run of them
+			 * takes one disk command. */
+			off_t run_bytes = size < inode_left ? size : inode_left;
+			size_t sector_cnt = run_bytes / DISK_SECTOR_SIZE;
+
+			disk_read_multiple (filesys_disk, sector_idx, buffer + bytes_read,
+					sector_cnt);
+			chunk_size = sector_cnt * DISK_SECTOR_SIZE;
 		} else {
 			/* Read sector into bounce buffer, then partially copy
 			 * into caller's buffer. */
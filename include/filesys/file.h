@@ -15,6 +15,7 @@ struct file {
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
 	int dup2_count;				/* Dup2 */
+	struct userfault *uffd;     /* Userfault object instead of an inode. */
 };
 
 struct inode;
@@ -23,6 +24,7 @@ struct inode;
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
 struct file *file_duplicate (struct file *file);
+struct file *file_open_userfault (struct userfault *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
 
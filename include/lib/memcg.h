@@ -0,0 +1,20 @@
+#ifndef __LIB_MEMCG_H
+#define __LIB_MEMCG_H
+
+#include <stddef.h>
+
+/* Memory cgroups are groups of processes whose resident frames are
+   limited together.  A process starts in its parent's group; the
+   first one is in the root group, which has no limit. */
+#define MEMCG_ROOT 0                /* Id of the root group. */
+
+/* What memcg_stat() fills in. */
+struct memcg_stat {
+	size_t limit;               /* Most frames, or 0 for no limit. */
+	size_t usage;               /* Frames charged to the group now. */
+	size_t peak;                /* Most frames charged at once. */
+	long long reclaim_cnt;      /* Frames evicted to keep within LIMIT. */
+	long long evict_cnt;        /* Frames evicted for any reason. */
+};
+
+#endif /* lib/memcg.h */
@@ -36,6 +36,17 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra for Project 3 */
+	SYS_MSYNC,                  /* Write back a mapped range. */
+	SYS_MADVISE,                /* Advise how a range will be used. */
+	SYS_VMSTAT,                 /* Read virtual memory statistics. */
+	SYS_USERFAULTFD,            /* Create a userfault object. */
+	SYS_UFFD_REGISTER,          /* Map an area whose faults it handles. */
+	SYS_UFFD_COPY,              /* Fill pages that faulted. */
+	SYS_MEMCG_NEW,              /* Create a memory cgroup. */
+	SYS_MEMCG_JOIN,             /* Move to a memory cgroup. */
+	SYS_MEMCG_STAT,             /* Read a memory cgroup's statistics. */
 };
 
 #endif /* lib/syscall-nr.h */
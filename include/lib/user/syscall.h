@@ -4,6 +4,9 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <memcg.h>
+#include <userfault.h>
+#include <vmstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -13,6 +16,16 @@ typedef int pid_t;
 typedef int off_t;
 #define MAP_FAILED ((void *) NULL)
 
+/* Or'ed into mmap()'s WRITABLE to load the whole mapping at once. */
+#define MAP_POPULATE 0x100
+
+/* Advice for madvise(). */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect page references in random order. */
+#define MADV_SEQUENTIAL 2       /* Expect page references in order. */
+#define MADV_WILLNEED 3         /* Will need these pages soon. */
+#define MADV_DONTNEED 4         /* Will not need these pages soon. */
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -41,6 +54,15 @@ int dup2(int oldfd, int newfd);
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int msync (void *addr, size_t length);
+int madvise (void *addr, size_t length, int advice);
+int vmstat (int which, struct vmstat *stats);
+int userfaultfd (void);
+int uffd_register (int fd, void *addr, size_t length);
+int uffd_copy (int fd, void *dst, const void *src, size_t length);
+int memcg_new (size_t limit);
+int memcg_join (int id);
+int memcg_stat (int id, struct memcg_stat *stat);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -78,4 +100,32 @@ get_fs_disk_write_cnt (void) {
 	return write_cnt;
 }
 
+static inline long long
+get_swap_disk_read_cnt (void) {
+	long long read_cnt;
+	asm volatile ("movq $1, %rdx");
+	asm volatile ("movq $1, %rcx");
+	asm volatile ("int $0x43");
+	asm volatile ("\t movq %%rax, %0": "=r" (read_cnt));
+	return read_cnt;
+}
+
+static inline long long
+get_swap_disk_write_cnt (void) {
+	long long write_cnt;
+	asm volatile ("movq $1, %rdx");
+	asm volatile ("movq $1, %rcx");
+	asm volatile ("int $0x44");
+	asm volatile ("\t movq %%rax, %0": "=r" (write_cnt));
+	return write_cnt;
+}
+
+static inline long long
+get_page_fault_cnt (void) {
+	long long fault_cnt;
+	asm volatile ("int $0x45");
+	asm volatile ("\t movq %%rax, %0": "=r" (fault_cnt));
+	return fault_cnt;
+}
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,11 @@
+#ifndef __LIB_USERFAULT_H
+#define __LIB_USERFAULT_H
+
+/* What read() on a userfault descriptor returns: a page that a
+   process faulted on and that waits for uffd_copy() to fill it. */
+struct uffd_msg {
+	void *addr;                 /* Page that faulted. */
+	int pid;                    /* Process that faulted on it. */
+};
+
+#endif /* lib/userfault.h */
@@ -0,0 +1,44 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Virtual memory events, counted for each process and for the
+   whole system, and read with the vmstat() system call. */
+enum vm_event {
+	VM_EV_MINOR_FAULT,          /* Faults resolved without I/O. */
+	VM_EV_MAJOR_FAULT,          /* Faults that read a file or swap. */
+	VM_EV_COW_FAULT,            /* Writes to pages mapped read-only to share. */
+	VM_EV_STACK_GROWTH,         /* Times a stack grew. */
+	VM_EV_EVICT,                /* Frames evicted. */
+	VM_EV_SWAP_IN,              /* Pages read back from swap. */
+	VM_EV_SWAP_OUT,             /* Pages written to swap. */
+	VM_EV_PAGE_IN,              /* Pages read from files. */
+	VM_EV_WRITE_BACK,           /* Pages written back to files. */
+	VM_EV_USER_FAULT,           /* Faults filled by a userfault handler. */
+	VM_EV_CNT                   /* Number of events. */
+};
+
+/* Kinds of page fault, each with a latency histogram. */
+enum vm_fault_kind {
+	VM_FAULT_MINOR,
+	VM_FAULT_MAJOR,
+	VM_FAULT_COW,
+	VM_FAULT_USER,              /* Round trips to a userfault handler. */
+	VM_FAULT_KINDS              /* Number of kinds. */
+};
+
+/* Bucket I of a latency histogram counts faults that took between
+   2**I and 2**(I+1) - 1 CPU cycles. */
+#define VMSTAT_BUCKETS 48
+
+/* Counters read by vmstat(). */
+#define VMSTAT_SELF 0               /* The calling process's. */
+#define VMSTAT_GLOBAL 1             /* The whole system's. */
+
+/* What vmstat() fills in.  The latency histograms are always the
+   whole system's. */
+struct vmstat {
+	long long events[VM_EV_CNT];
+	long long latency[VM_FAULT_KINDS][VMSTAT_BUCKETS];
+};
+
+#endif /* lib/vmstat.h */
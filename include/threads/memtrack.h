@@ -0,0 +1,18 @@
+#ifndef THREADS_MEMTRACK_H
+#define THREADS_MEMTRACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Index of a call site in the memtrack table. */
+typedef uint16_t memtrack_site_t;
+
+/* -mt: Tag every malloc() and palloc_get_page() with its call site? */
+extern bool memtrack_enabled;
+
+memtrack_site_t memtrack_alloc (const void *site, size_t bytes);
+void memtrack_free (memtrack_site_t site, size_t bytes);
+void memtrack_print_stats (void);
+
+#endif /* threads/memtrack.h */
@@ -0,0 +1,23 @@
+#ifndef THREADS_NUMA_H
+#define THREADS_NUMA_H
+
+#include <stdint.h>
+
+/* Most nodes we keep apart.  Memory of other nodes counts as
+   node 0's. */
+#define NUMA_MAX_NODES 8
+
+/* Physical memory of a node, [START, END). */
+struct numa_node {
+	uint64_t start;
+	uint64_t end;
+};
+
+extern struct numa_node numa_nodes[NUMA_MAX_NODES];
+extern unsigned numa_node_cnt;
+
+void numa_init (void);
+unsigned numa_node_of (uint64_t pa);
+unsigned numa_current_node (void);
+
+#endif /* threads/numa.h */
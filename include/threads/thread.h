@@ -155,6 +155,21 @@ struct thread {
 	struct supplemental_page_table spt;
 	/* Stack Growth */
 	void *rsp;
+
+	/* Page Replacement */
+	size_t rss_pages;                   /* Resident frames. */
+	size_t wss_pages;                   /* Working-set estimate. */
+	size_t wss_scan;                    /* Scratch for the scanner. */
+
+	/* Fault Around */
+	void *fault_next;                   /* Page a sequential scan faults on next. */
+	size_t fault_window;                /* Pages to map ahead of a fault. */
+
+	/* VM Statistics */
+	long long vm_events[VM_EV_CNT];     /* Counts of enum vm_event. */
+
+	/* Memory Cgroups */
+	struct memcg *memcg;                /* Group, or NULL for the root. */
 #endif
 
 	/* Owned by thread.c. */
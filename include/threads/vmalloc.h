@@ -0,0 +1,24 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* Kernel virtual region for virtually contiguous allocations.
+ * It lives in its own page-map-level-4 slot, above the direct
+ * mapping of physical memory at KERN_BASE. */
+#define VMALLOC_START 0x10000000000
+#define VMALLOC_PAGES (1 << 14)     /* 64 MB of address space. */
+#define VMALLOC_END (VMALLOC_START + (uint64_t) VMALLOC_PAGES * PGSIZE)
+
+/* Returns true if VADDR lies in the vmalloc region. */
+#define is_vmalloc_vaddr(vaddr) \
+	((uint64_t) (vaddr) >= VMALLOC_START && (uint64_t) (vaddr) < VMALLOC_END)
+
+void vmalloc_init (void);
+void *vmalloc (size_t page_cnt);
+void vfree (void *pages, size_t page_cnt);
+
+#endif /* threads/vmalloc.h */
@@ -6,10 +6,14 @@ enum vm_type;
 
 struct anon_page {
     /* Anonymous Page */
-    int swap_info;
+    int swap_info;      /* Swap slot holding the page, or -1. */
 };
 
 void vm_anon_init (void);
+void vm_anon_print_stats (void);
+void anon_dup_swap_slot (struct page *page);
+void anon_swap_batch_begin (void);
+void anon_swap_batch_end (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
 
 #endif
@@ -7,6 +7,10 @@ struct page;
 enum vm_type;
 
 struct file_page {
+	/* Memory Mapped Files */
+	struct file *file;          /* File of the mapping, owned by its VMA. */
+	off_t ofs;                  /* Offset of the page in FILE. */
+	size_t read_bytes;          /* Bytes backed by FILE; the rest are zero. */
 };
 
 void vm_file_init (void);
@@ -14,4 +18,9 @@ bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+int do_msync (void *addr, size_t length);
+
+/* Memory Mapped Files */
+off_t vm_file_read (struct file *file, void *buffer, off_t size);
+off_t vm_file_write (struct file *file, const void *buffer, off_t size);
 #endif
@@ -0,0 +1,35 @@
+#ifndef VM_MEMCG_H
+#define VM_MEMCG_H
+#include <memcg.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct thread;
+
+/* Most groups, counting the root group. */
+#define MEMCG_MAX 16
+
+/* A memory cgroup.  The charges and counters are protected by
+ * frame_lock in vm.c. */
+struct memcg {
+	int id;                     /* Index in the group table. */
+	bool in_use;                /* Created yet? */
+	size_t limit;               /* Most frames, or 0 for no limit. */
+	size_t usage;               /* Frames charged to the group. */
+	size_t peak;                /* Most frames charged at once. */
+	long long reclaim_cnt;      /* Frames evicted to keep within LIMIT. */
+	long long evict_cnt;        /* Frames evicted for any reason. */
+};
+
+void memcg_init (void);
+struct memcg *memcg_alloc (size_t limit);
+struct memcg *memcg_lookup (int id);
+struct memcg *memcg_of (struct thread *);
+
+void memcg_charge (struct memcg *);
+void memcg_uncharge (struct memcg *);
+bool memcg_at_limit (const struct memcg *);
+void memcg_get_stat (const struct memcg *, struct memcg_stat *);
+void memcg_print_stats (void);
+
+#endif /* vm/memcg.h */
@@ -0,0 +1,21 @@
+#ifndef VM_USERFAULT_H
+#define VM_USERFAULT_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct page;
+struct supplemental_page_table;
+
+struct userfault *userfault_create (void);
+struct userfault *userfault_reopen (struct userfault *);
+void userfault_close (struct userfault *);
+void userfault_put (struct userfault *);
+
+bool userfault_register (struct userfault *, struct supplemental_page_table *,
+		void *addr, size_t length);
+int userfault_read (struct userfault *, void *buffer, unsigned size);
+int userfault_copy (struct userfault *, void *dst, const void *src,
+		size_t length);
+bool userfault_page_in (struct page *page, void *aux);
+
+#endif /* vm/userfault.h */
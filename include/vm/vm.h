@@ -6,6 +6,9 @@
 /* Memory Management */
 #include "hash.h"
 
+/* VM Statistics */
+#include <vmstat.h>
+
 enum vm_type {
 	/* page not initialized */
 	VM_UNINIT = 0,
@@ -30,6 +33,7 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/vma.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -56,6 +60,19 @@ struct page {
 	/* Anonymous Page */
 	int page_count;
 
+	/* Copy on Write */
+	struct thread *owner;          /* Process whose address space holds this. */
+	struct list_elem map_elem;     /* Element in frame's PAGES list. */
+
+	/* Frame Cache */
+	struct inode *cache_inode;     /* File the page may share a frame of, or NULL. */
+	off_t cache_ofs;               /* Offset of the page's bytes in CACHE_INODE. */
+	size_t cache_read_bytes;       /* Bytes read; the rest are zero. */
+	bool cache_shared;             /* Shared mapping, rather than private text? */
+
+	/* Zero Page */
+	bool zero_mapped;              /* Mapped to the shared zero frame? */
+
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
 	union {
@@ -71,10 +88,36 @@ struct page {
 /* The representation of "frame" */
 struct frame {
 	void *kva;
-	struct page *page;
+	struct page *page;      /* First of PAGES, or NULL. */
+
+	/* Page Replacement */
+	bool active;            /* On the active list? */
 
 	/* Memory Management */
 	struct list_elem frame_elem;
+
+	/* Copy on Write */
+	/* Every page mapping this frame.  More than one page means the
+	 * frame is shared copy-on-write and mapped read-only. */
+	struct list pages;
+	int ref_cnt;            /* Number of elements in PAGES. */
+	int swap_slot;          /* Slot written during eviction, or -1. */
+
+	/* Frame Cache */
+	struct cached_frame *cached;  /* Entry in the frame cache, or NULL. */
+
+	/* Same-Page Merging */
+	struct list_elem ksm_elem;    /* Element in a bucket of ksm_table. */
+	bool ksm_listed;              /* In ksm_table? */
+	bool ksm_merged;              /* Holds pages merged by ksmd? */
+	unsigned ksm_pass;            /* Scan pass that last looked at it, or 0. */
+	unsigned ksm_checksum;        /* Checksum of its bytes then. */
+
+	/* Memory Cgroups */
+	struct memcg *memcg;          /* Group charged, or NULL if none. */
+
+	/* Page Out Daemon */
+	bool evicting;                /* Pages being written out? */
 };
 
 /* The function table for page operations.
@@ -99,7 +142,13 @@ struct page_operations {
 struct supplemental_page_table {
 
 	/* Memory Management */
-	struct hash hash_page;
+	struct hash hash_page;     /* Pages touched so far, by address. */
+
+	/* VMA */
+	struct vma_tree vmas;      /* Areas the pages are created from. */
+
+	/* Range Operations */
+	bool bulk_unmap;           /* Leave PTEs for one pml4_unmap_range()? */
 
 };
 
@@ -110,8 +159,11 @@ bool supplemental_page_table_copy (struct supplemental_page_table *dst,
 void supplemental_page_table_kill (struct supplemental_page_table *spt);
 struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
+struct page *spt_get_page (struct supplemental_page_table *spt, void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+size_t spt_remove_range (struct supplemental_page_table *spt, void *start,
+		void *end);
 
 void vm_init (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
@@ -125,6 +177,37 @@ void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
 enum vm_type page_get_type (struct page *page);
 
+/* Page Replacement */
+void vm_print_stats (void);
+
+/* Frame Cache */
+void vm_share_text (struct vma *vma);
+bool vm_cache_copy (struct inode *inode, off_t ofs, size_t read_bytes,
+		size_t page_ofs, void *buf, size_t size, bool to_frame);
+
+/* Madvise */
+int vm_madvise (void *addr, size_t length, int advice);
+
+/* Populate */
+size_t vm_populate (void *addr, void *end);
+bool vm_populate_exec (const char *prog);
+extern const char *vm_populate_progs;
+
+/* VM Statistics */
+void vm_count_event (struct thread *t, enum vm_event event);
+void vm_get_stats (struct vmstat *stats, bool global);
+
+/* Same-Page Merging */
+extern size_t vm_ksm_pages;
+
+/* Stack Growth */
+extern size_t vm_stack_pages;
+extern size_t vm_stack_prefault;
+
+/* Page Out Daemon */
+extern size_t vm_low_wmark;
+extern size_t vm_high_wmark;
+
 /* Memory Management */
 static unsigned vm_hash_func (const struct hash_elem *e, void *aux);
 static bool vm_less_func (const struct hash_elem *a, const struct hash_elem *b, void *aux);
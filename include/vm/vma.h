@@ -0,0 +1,68 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/vm.h"
+
+struct file;
+struct page;
+
+/* Advice given with madvise(), as in lib/user/syscall.h. */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect page references in random order. */
+#define MADV_SEQUENTIAL 2       /* Expect page references in order. */
+#define MADV_WILLNEED 3         /* Will need these pages soon. */
+#define MADV_DONTNEED 4         /* Will not need these pages soon. */
+
+/* Or'ed into mmap()'s WRITABLE, as in lib/user/syscall.h. */
+#define MAP_POPULATE 0x100      /* Load the whole mapping at once. */
+
+/* A virtual memory area: a run of pages of one address space that
+ * are all set up the same way.  A page of the area gets its struct
+ * page only when it is first touched, so mapping a large region
+ * costs one of these, not one allocation per page. */
+struct vma {
+	void *start;                /* First page. */
+	void *end;                  /* One past the last page. */
+	enum vm_type type;          /* Type given to the area's pages. */
+	bool writable;
+	struct file *file;          /* Backing file, or NULL for zeros. */
+	off_t ofs;                  /* Offset of START in FILE. */
+	size_t read_bytes;          /* Bytes read from FILE; the rest are zero. */
+	int advice;                 /* MADV_NORMAL, _RANDOM or _SEQUENTIAL. */
+	struct userfault *uffd;     /* Handles the area's faults, or NULL. */
+
+	/* AVL tree links, ordered by START. */
+	struct vma *left, *right;
+	int height;
+};
+
+/* The areas of one address space.  They never overlap. */
+struct vma_tree {
+	struct vma *root;
+	size_t cnt;                 /* Number of areas. */
+};
+
+void vma_tree_init (struct vma_tree *tree);
+bool vma_tree_copy (struct vma_tree *dst, const struct vma_tree *src);
+void vma_tree_destroy (struct vma_tree *tree);
+
+struct vma *vma_create (struct vma_tree *tree, void *start, size_t page_cnt,
+		enum vm_type type, bool writable, struct file *file, off_t ofs,
+		size_t read_bytes);
+void vma_remove (struct vma_tree *tree, struct vma *vma);
+struct vma *vma_find (const struct vma_tree *tree, const void *va);
+struct vma *vma_first_in (const struct vma_tree *tree, const void *start,
+		const void *end);
+struct vma *vma_next (const struct vma_tree *tree, const struct vma *vma);
+bool vma_covers (const struct vma_tree *tree, const void *start,
+		const void *end);
+bool vma_grow_down (struct vma_tree *tree, struct vma *vma, void *start,
+		size_t gap);
+
+off_t vma_page_ofs (const struct vma *vma, const void *upage);
+size_t vma_page_read_bytes (const struct vma *vma, const void *upage);
+bool vma_load_page (struct page *page, void *aux);
+
+#endif /* vm/vma.h */
@@ -0,0 +1,18 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Pages of kernel memory that hold compressed swap slots, or 0 to
+ * send every swapped page to disk. */
+extern size_t zswap_pool_pages;
+
+void zswap_init (size_t slot_cnt, void (*write_back) (size_t slot,
+			const void *kva));
+bool zswap_store (size_t slot, const void *kva);
+bool zswap_load (size_t slot, void *kva);
+bool zswap_contains (size_t slot);
+void zswap_forget (size_t slot);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */
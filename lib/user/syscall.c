@@ -54,7 +54,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3) ( \
-		syscall(((uint64_t *) NUMBER), \
+		syscall(((uint64_t) NUMBER), \
 			((uint64_t) ARG0), \
 			((uint64_t) ARG1), \
 			((uint64_t) ARG2), \
@@ -155,6 +155,51 @@ munmap (void *addr) {
 	syscall1 (SYS_MUNMAP, addr);
 }
 
+int
+msync (void *addr, size_t length) {
+	return syscall2 (SYS_MSYNC, addr, length);
+}
+
+int
+madvise (void *addr, size_t length, int advice) {
+	return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+int
+vmstat (int which, struct vmstat *stats) {
+	return syscall2 (SYS_VMSTAT, which, stats);
+}
+
+int
+userfaultfd (void) {
+	return syscall0 (SYS_USERFAULTFD);
+}
+
+int
+uffd_register (int fd, void *addr, size_t length) {
+	return syscall3 (SYS_UFFD_REGISTER, fd, addr, length);
+}
+
+int
+uffd_copy (int fd, void *dst, const void *src, size_t length) {
+	return syscall4 (SYS_UFFD_COPY, fd, dst, src, length);
+}
+
+int
+memcg_new (size_t limit) {
+	return syscall1 (SYS_MEMCG_NEW, limit);
+}
+
+int
+memcg_join (int id) {
+	return syscall1 (SYS_MEMCG_JOIN, id);
+}
+
+int
+memcg_stat (int id, struct memcg_stat *stat) {
+	return syscall2 (SYS_MEMCG_STAT, id, stat);
+}
+
 bool
 chdir (const char *dir) {
 	return syscall1 (SYS_CHDIR, dir);
@@ -0,0 +1,81 @@
+/* Measures the cost of read and write system calls of a page,
+   where the time to move the data between the file and the user
+   buffer dominates.  Writes a file a page at a time, reads it back
+   the same way, and checks what it read.  See rw-small for calls
+   that move only 16 bytes. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define RECORD 4096                     /* Bytes per call. */
+#define FILE_SIZE (16 * 4096)           /* Bytes in the file. */
+#define PASSES 8                        /* Times through the file. */
+#define CALLS (PASSES * FILE_SIZE / RECORD)
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Fills RECORD with the bytes that belong at offset OFS. */
+static void
+fill (char record[RECORD], int ofs)
+{
+  int i;
+
+  for (i = 0; i < RECORD; i++)
+    record[i] = (char) ((ofs + i) * 7 + 1);
+}
+
+void
+test_main (void)
+{
+  static char record[RECORD], expected[RECORD];
+  uint64_t start, write_cycles, read_cycles;
+  int handle, pass, ofs;
+
+  CHECK (create ("rw.txt", FILE_SIZE), "create \"rw.txt\"");
+  CHECK ((handle = open ("rw.txt")) > 1, "open \"rw.txt\"");
+
+  write_cycles = 0;
+  for (pass = 0; pass < PASSES; pass++)
+    {
+      seek (handle, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += RECORD)
+        {
+          fill (record, ofs);
+          start = rdtsc ();
+          if (write (handle, record, RECORD) != RECORD)
+            fail ("write of %d bytes at offset %d failed", RECORD, ofs);
+          write_cycles += rdtsc () - start;
+        }
+    }
+
+  read_cycles = 0;
+  for (pass = 0; pass < PASSES; pass++)
+    {
+      seek (handle, 0);
+      for (ofs = 0; ofs < FILE_SIZE; ofs += RECORD)
+        {
+          start = rdtsc ();
+          if (read (handle, record, RECORD) != RECORD)
+            fail ("read of %d bytes at offset %d failed", RECORD, ofs);
+          read_cycles += rdtsc () - start;
+          fill (expected, ofs);
+          if (memcmp (record, expected, RECORD))
+            fail ("data read at offset %d differs from data written", ofs);
+        }
+    }
+  close (handle);
+
+  msg ("write: %d calls, %llu cycles per call", CALLS,
+       (unsigned long long) (write_cycles / CALLS));
+  msg ("read: %d calls, %llu cycles per call", CALLS,
+       (unsigned long long) (read_cycles / CALLS));
+}
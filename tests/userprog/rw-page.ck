@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Timings vary, so check everything else exactly.
+s/, \d+ cycles per call$/, N cycles per call/ foreach @output;
+compare_output ("run", \@output, [<<'EOF']);
+(rw-page) begin
+(rw-page) create "rw.txt"
+(rw-page) open "rw.txt"
+(rw-page) write: 128 calls, N cycles per call
+(rw-page) read: 128 calls, N cycles per call
+(rw-page) end
+rw-page: exit(0)
+EOF
+pass;
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Timings vary, so check everything else exactly.
+s/, \d+ cycles per call$/, N cycles per call/ foreach @output;
+compare_output ("run", \@output, [<<'EOF']);
+(rw-small) begin
+(rw-small) create "rw.txt"
+(rw-small) open "rw.txt"
+(rw-small) write: 2048 calls, N cycles per call
+(rw-small) read: 2048 calls, N cycles per call
+(rw-small) end
+rw-small: exit(0)
+EOF
+pass;
@@ -0,0 +1,38 @@
+/* Sums every byte of the 2 MB array in its data segment, as a
+   program that needs all of its data before it can do useful work
+   would.  Exits with the number of page faults that took, at most
+   255.  Built twice, as child-big and child-big-pop, so that
+   page-populate can exec it with and without the -populate
+   option. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/vm/large.inc"
+
+static struct vmstat before, after;
+
+int
+main (void)
+{
+  unsigned long sum = 0;
+  long long faults;
+  size_t i;
+
+  test_name = "child-big";
+
+  /* Fault on the counters' own pages before reading them. */
+  memset (&before, 0, sizeof before);
+  memset (&after, 0, sizeof after);
+
+  vmstat (VMSTAT_SELF, &before);
+  for (i = 0; i < sizeof large; i++)
+    sum += large[i];
+  vmstat (VMSTAT_SELF, &after);
+
+  if (sum == 0)
+    fail ("data segment reads as zeros");
+  faults = after.events[VM_EV_MINOR_FAULT] + after.events[VM_EV_MAJOR_FAULT]
+           - before.events[VM_EV_MINOR_FAULT] - before.events[VM_EV_MAJOR_FAULT];
+  return faults < 255 ? faults : 255;
+}
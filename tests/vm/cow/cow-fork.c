@@ -0,0 +1,55 @@
+/* Measures fork latency as the parent's resident set grows.
+   With copy-on-write, forking should cost about the same whether
+   the parent has touched 64 kB or 2 MB, because no page is copied
+   until someone writes to it.  The child writes to one page to
+   check that the parent's copy is left alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define MAX_SIZE (2 * 1024 * 1024)
+
+static char buf[MAX_SIZE];
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+void
+test_main (void)
+{
+  size_t size, i;
+
+  for (size = 64 * 1024; size <= MAX_SIZE; size *= 2)
+    {
+      uint64_t start, cycles;
+      pid_t child;
+
+      /* Make SIZE bytes resident. */
+      for (i = 0; i < size; i += PAGE_SIZE)
+        buf[i] = 'p';
+
+      start = rdtsc ();
+      child = fork ("child");
+      if (child == 0)
+        {
+          buf[0] = 'c';
+          exit (buf[0] == 'c' ? 0 : 1);
+        }
+      cycles = rdtsc () - start;
+
+      CHECK (wait (child) == 0, "wait for child");
+      if (buf[0] != 'p')
+        fail ("child's write changed the parent's page");
+      msg ("fork with %zu kB resident: %llu kcycles", size / 1024,
+           (unsigned long long) (cycles / 1000));
+    }
+}
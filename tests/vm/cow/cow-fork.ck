@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Cycle counts vary from run to run, so only their presence is
+# checked.
+s/: \d+ kcycles$/: N kcycles/ foreach @output;
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(cow-fork) begin
+(cow-fork) wait for child
+(cow-fork) fork with 64 kB resident: N kcycles
+(cow-fork) wait for child
+(cow-fork) fork with 128 kB resident: N kcycles
+(cow-fork) wait for child
+(cow-fork) fork with 256 kB resident: N kcycles
+(cow-fork) wait for child
+(cow-fork) fork with 512 kB resident: N kcycles
+(cow-fork) wait for child
+(cow-fork) fork with 1024 kB resident: N kcycles
+(cow-fork) wait for child
+(cow-fork) fork with 2048 kB resident: N kcycles
+(cow-fork) end
+EOF
+pass;
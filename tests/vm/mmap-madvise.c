@@ -0,0 +1,47 @@
+/* Gives every kind of madvise() advice for a mapping, writes
+   through it, syncs it with msync(), drops it with MADV_DONTNEED,
+   and checks that the written data is read back from the file.
+   Also checks that both calls reject ranges that are not mapped. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+#define UNMAPPED ((void *) 0x20000000)
+
+static const char overwrite[] = "Synced, dropped and read back";
+
+void
+test_main (void)
+{
+  int handle;
+  void *map;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (ACTUAL, 4096, 1, handle, 0)) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+
+  CHECK (madvise (map, 4096, MADV_SEQUENTIAL) == 0, "madvise sequential");
+  CHECK (madvise (map, 4096, MADV_RANDOM) == 0, "madvise random");
+  CHECK (madvise (map, 4096, MADV_NORMAL) == 0, "madvise normal");
+  CHECK (madvise (map, 4096, MADV_WILLNEED) == 0, "madvise willneed");
+  CHECK (!memcmp (ACTUAL, sample, strlen (sample)),
+         "compare mapped data against file");
+
+  memcpy (ACTUAL, overwrite, strlen (overwrite));
+  CHECK (msync (map, 4096) == 0, "msync");
+  CHECK (madvise (map, 4096, MADV_DONTNEED) == 0, "madvise dontneed");
+  CHECK (!memcmp (ACTUAL, overwrite, strlen (overwrite)),
+         "compare mapped data against written data");
+
+  CHECK (msync (UNMAPPED, 4096) == -1, "msync unmapped range");
+  CHECK (madvise (UNMAPPED, 4096, MADV_WILLNEED) == -1,
+         "madvise unmapped range");
+  CHECK (madvise (map, 4096, 99) == -1, "madvise bad advice");
+
+  munmap (map);
+  close (handle);
+}
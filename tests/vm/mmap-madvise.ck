@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-madvise) begin
+(mmap-madvise) open "sample.txt"
+(mmap-madvise) mmap "sample.txt"
+(mmap-madvise) madvise sequential
+(mmap-madvise) madvise random
+(mmap-madvise) madvise normal
+(mmap-madvise) madvise willneed
+(mmap-madvise) compare mapped data against file
+(mmap-madvise) msync
+(mmap-madvise) madvise dontneed
+(mmap-madvise) compare mapped data against written data
+(mmap-madvise) msync unmapped range
+(mmap-madvise) madvise unmapped range
+(mmap-madvise) madvise bad advice
+(mmap-madvise) end
+EOF
+pass;
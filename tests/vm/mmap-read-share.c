@@ -0,0 +1,45 @@
+/* Writes to a file through a mapping and checks that read() on
+   another descriptor sees the data before the file is unmapped,
+   then writes with write() and checks that the mapping sees it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+static const char overwrite[] = "Mapped and read back";
+static const char rewrite[] = "Written and seen mapped";
+
+void
+test_main (void)
+{
+  int map_handle, rw_handle;
+  void *map;
+  char buf[sizeof sample];
+
+  CHECK ((map_handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((rw_handle = open ("sample.txt")) > 1, "open \"sample.txt\" again");
+  CHECK ((map = mmap (ACTUAL, 4096, 1, map_handle, 0)) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+
+  /* Write through the mapping, read with read(). */
+  memcpy (ACTUAL, overwrite, strlen (overwrite));
+  CHECK (read (rw_handle, buf, strlen (sample)) == (int) strlen (sample),
+         "read \"sample.txt\"");
+  CHECK (!memcmp (buf, ACTUAL, strlen (sample)),
+         "compare read data against mapped data");
+
+  /* Write with write(), read through the mapping. */
+  seek (rw_handle, 0);
+  CHECK (write (rw_handle, rewrite, strlen (rewrite)) == (int) strlen (rewrite),
+         "write \"sample.txt\"");
+  CHECK (!memcmp (ACTUAL, rewrite, strlen (rewrite)),
+         "compare mapped data against written data");
+
+  munmap (map);
+  close (rw_handle);
+  close (map_handle);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mmap-read-share) begin
+(mmap-read-share) open "sample.txt"
+(mmap-read-share) open "sample.txt" again
+(mmap-read-share) mmap "sample.txt"
+(mmap-read-share) read "sample.txt"
+(mmap-read-share) compare read data against mapped data
+(mmap-read-share) write "sample.txt"
+(mmap-read-share) compare mapped data against written data
+(mmap-read-share) end
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Fills many pages with the same bytes and keeps reading them for
+   a while, so that ksmd, which this test turns on, merges them.
+   Then writes a different byte to each page and checks that every
+   page sees only its own write. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 64
+#define PAGE_SIZE 4096
+#define ROUNDS 100
+
+static char buf[PAGE_CNT][PAGE_SIZE];
+
+/* Returns the byte expected at offset OFS of every page before the
+   writes. */
+static char
+pattern (size_t ofs)
+{
+  return ofs % 251;
+}
+
+void
+test_main (void)
+{
+  size_t page, ofs;
+  int round;
+
+  for (page = 0; page < PAGE_CNT; page++)
+    for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+      buf[page][ofs] = pattern (ofs);
+  msg ("filled %d identical pages", PAGE_CNT);
+
+  for (round = 0; round < ROUNDS; round++)
+    for (page = 0; page < PAGE_CNT; page++)
+      for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+        if (buf[page][ofs] != pattern (ofs))
+          fail ("page %zu, byte %zu changed while reading", page, ofs);
+  msg ("read them %d times", ROUNDS);
+
+  for (page = 0; page < PAGE_CNT; page++)
+    buf[page][page] = 'x';
+  for (page = 0; page < PAGE_CNT; page++)
+    for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+      if (buf[page][ofs] != (ofs == page ? 'x' : pattern (ofs)))
+        fail ("page %zu, byte %zu is wrong after the writes", page, ofs);
+  msg ("wrote to each page and read them back");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-ksm) begin
+(page-ksm) filled 64 identical pages
+(page-ksm) read them 100 times
+(page-ksm) wrote to each page and read them back
+(page-ksm) end
+EOF
+pass;
@@ -0,0 +1,76 @@
+/* Puts a child that streams through 4 MB of memory, more than
+   fits in user memory, in a memory cgroup limited to 64 frames,
+   while this process keeps a working set of 64 pages.  The child
+   pages against its own frames, so none of the working set should
+   have to come back from swap, and the group should never hold
+   more frames than its limit.
+   For this test, Pintos memory size is 8MB. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HOT_PAGES 64
+#define STREAM_PAGES 1024
+#define LIMIT 64
+
+static char hot[HOT_PAGES][PAGE_SIZE];
+static char stream[STREAM_PAGES][PAGE_SIZE];
+
+/* Writes every page of the stream, then reads them all back.
+   Returns true if they held what was written. */
+static bool
+stream_pages (void)
+{
+  size_t i;
+
+  for (i = 0; i < STREAM_PAGES; i++)
+    stream[i][0] = i;
+  for (i = 0; i < STREAM_PAGES; i++)
+    if (stream[i][0] != (char) i)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  struct vmstat before, after;
+  struct memcg_stat stat;
+  pid_t child;
+  int id;
+  size_t i;
+
+  for (i = 0; i < HOT_PAGES; i++)
+    memset (hot[i], i, PAGE_SIZE);
+
+  CHECK ((id = memcg_new (LIMIT)) > MEMCG_ROOT, "memcg_new");
+  child = fork ("noisy");
+  if (child == 0)
+    {
+      if (memcg_join (id) != 0)
+        exit (1);
+      exit (stream_pages () ? 0 : 2);
+    }
+  CHECK (wait (child) == 0, "wait for noisy neighbor");
+
+  /* The working set must still be resident. */
+  vmstat (VMSTAT_SELF, &before);
+  for (i = 0; i < HOT_PAGES; i++)
+    if (hot[i][PAGE_SIZE - 1] != (char) i)
+      fail ("hot page %zu is corrupted", i);
+  vmstat (VMSTAT_SELF, &after);
+  if (after.events[VM_EV_SWAP_IN] != before.events[VM_EV_SWAP_IN])
+    fail ("%lld hot pages were swapped out",
+          after.events[VM_EV_SWAP_IN] - before.events[VM_EV_SWAP_IN]);
+  msg ("working set stayed resident");
+
+  CHECK (memcg_stat (id, &stat) == 0, "memcg_stat");
+  if (stat.peak > LIMIT)
+    fail ("group held %zu frames, over its limit of %d", stat.peak, LIMIT);
+  if (stat.reclaim_cnt == 0)
+    fail ("group never reclaimed its own frames");
+  msg ("group stayed within its limit");
+}
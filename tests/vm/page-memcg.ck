@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-memcg) begin
+(page-memcg) memcg_new
+(page-memcg) wait for noisy neighbor
+(page-memcg) working set stayed resident
+(page-memcg) memcg_stat
+(page-memcg) group stayed within its limit
+(page-memcg) end
+EOF
+pass;
@@ -0,0 +1,24 @@
+/* Touches a few hundred pages on a machine split into two NUMA
+   nodes.  The CPU is on node 0, whose share of user memory holds
+   them all, so none should have to come from node 1. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs < SIZE; ofs += 4096)
+    buf[ofs] = ofs / 4096;
+  for (ofs = 0; ofs < SIZE; ofs += 4096)
+    if (buf[ofs] != (char) (ofs / 4096))
+      fail ("byte %zu is %d, not %d", ofs, buf[ofs], (char) (ofs / 4096));
+  msg ("wrote %d pages and read them back", SIZE / 4096);
+}
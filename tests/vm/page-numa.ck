@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(page-numa) begin
+(page-numa) wrote 512 pages and read them back
+(page-numa) end
+EOF
+
+# The kernel prints how each node's user pages were used when it
+# powers off.
+my (@nodes) = grep (/^NUMA node \d+:/, @output);
+fail "kernel did not find 2 NUMA nodes\n" if @nodes != 2;
+my ($remote) = $nodes[0] =~ /(\d+) remote$/;
+fail "node 0 statistics not found\n" if !defined $remote;
+fail "$remote pages came from node 1 instead of node 0\n" if $remote != 0;
+pass;
@@ -0,0 +1,81 @@
+/* Compares the time it takes a program to get through its whole
+   2 MB data segment when exec loads it lazily, a page per fault,
+   and when the -populate option makes exec load it up front.  The
+   populated program must take no faults on its data.  Then maps a
+   file with MAP_POPULATE and checks that reading it takes no
+   faults either. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct vmstat before, after;
+
+static inline uint64_t
+rdtsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Runs PROG and returns the number of faults it reports, storing
+   the cycles from fork until it exits in *CYCLES. */
+static int
+run (const char *prog, uint64_t *cycles)
+{
+  uint64_t start = rdtsc ();
+  pid_t child;
+  int faults;
+
+  child = fork (prog);
+  if (child == 0)
+    CHECK (exec (prog) != -1, "exec \"%s\"", prog);
+  faults = wait (child);
+  *cycles = rdtsc () - start;
+  return faults;
+}
+
+void
+test_main (void)
+{
+  char *map = (char *) 0x10000000;
+  uint64_t lazy_cycles, populate_cycles;
+  int lazy_faults, populate_faults;
+  unsigned long sum = 0;
+  long long faults;
+  int handle, size, i;
+
+  lazy_faults = run ("child-big", &lazy_cycles);
+  populate_faults = run ("child-big-pop", &populate_cycles);
+  msg ("lazy: %d faults, %llu kcycles", lazy_faults,
+       (unsigned long long) (lazy_cycles / 1000));
+  msg ("populated: %d faults, %llu kcycles", populate_faults,
+       (unsigned long long) (populate_cycles / 1000));
+  if (lazy_faults <= 0)
+    fail ("lazily loaded child took no faults on its data");
+  if (populate_faults != 0)
+    fail ("populated child took %d faults on its data", populate_faults);
+
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+  size = filesize (handle);
+  CHECK (mmap (map, size, MAP_POPULATE, handle, 0) != MAP_FAILED,
+         "mmap \"large.txt\" with MAP_POPULATE");
+  memset (&before, 0, sizeof before);
+  memset (&after, 0, sizeof after);
+  vmstat (VMSTAT_SELF, &before);
+  for (i = 0; i < size; i += 4096)
+    sum += map[i];
+  vmstat (VMSTAT_SELF, &after);
+  faults = after.events[VM_EV_MINOR_FAULT] + after.events[VM_EV_MAJOR_FAULT]
+           - before.events[VM_EV_MINOR_FAULT] - before.events[VM_EV_MAJOR_FAULT];
+  if (sum == 0)
+    fail ("mapped file reads as zeros");
+  if (faults != 0)
+    fail ("reading the populated mapping took %lld faults", faults);
+  msg ("read the populated mapping without faults");
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# Fault counts and timings vary, so check everything else exactly.
+s/: \d+ faults, \d+ kcycles$/: N faults, N kcycles/ foreach @output;
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(page-populate) begin
+(page-populate) lazy: N faults, N kcycles
+(page-populate) populated: N faults, N kcycles
+(page-populate) open "large.txt"
+(page-populate) mmap "large.txt" with MAP_POPULATE
+(page-populate) read the populated mapping without faults
+(page-populate) end
+EOF
+pass;
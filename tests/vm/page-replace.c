@@ -0,0 +1,97 @@
+/* Page-replacement benchmark.  Touches working sets of 50%, 100%,
+   150% and 200% of user memory with a skewed access pattern, in
+   which most accesses go to a small hot set of pages, and reports
+   the page fault rate and swap disk traffic for each.  Data is
+   checked along the way, so the benchmark also fails if eviction
+   loses a page.
+   For this test, Pintos memory size is 10MB, which leaves about
+   4MB for user pages.  Working sets larger than that need a swap
+   disk; without one, only the 50% working set is measured. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ONE_MB (1 << 20)
+#define USER_MEM (4 * ONE_MB)
+#define MAX_PAGES (2 * USER_MEM / PAGE_SIZE)
+#define ACCESSES_PER_PAGE 8
+
+static char buf[MAX_PAGES * PAGE_SIZE];
+
+/* Simple linear congruential generator, so that runs are
+   repeatable. */
+static unsigned long seed = 1;
+
+static unsigned long
+next_random (void)
+{
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return seed >> 33;
+}
+
+/* Returns a page number below PAGE_CNT.  Four accesses out of
+   five go to the first fifth of the pages. */
+static size_t
+pick_page (size_t page_cnt)
+{
+  size_t hot_cnt = page_cnt / 5;
+
+  if (next_random () % 5 != 0)
+    return next_random () % hot_cnt;
+  return next_random () % page_cnt;
+}
+
+static void
+run (int percent)
+{
+  size_t page_cnt = (size_t) USER_MEM / PAGE_SIZE * percent / 100;
+  size_t access_cnt = page_cnt * ACCESSES_PER_PAGE;
+  long long faults, reads, writes;
+  size_t i;
+
+  /* Populate the working set. */
+  for (i = 0; i < page_cnt; i++)
+    buf[i * PAGE_SIZE] = (char) i;
+
+  faults = get_page_fault_cnt ();
+  reads = get_swap_disk_read_cnt ();
+  writes = get_swap_disk_write_cnt ();
+
+  /* Read every access, write one access in four. */
+  for (i = 0; i < access_cnt; i++)
+    {
+      size_t page = pick_page (page_cnt);
+      char *mem = buf + page * PAGE_SIZE;
+
+      if (*mem != (char) page)
+        fail ("page %zu is inconsistent", page);
+      if (i % 4 == 0)
+        mem[1] = (char) i;
+    }
+
+  faults = get_page_fault_cnt () - faults;
+  reads = get_swap_disk_read_cnt () - reads;
+  writes = get_swap_disk_write_cnt () - writes;
+  msg ("working set %d%%: %lld faults per 1000 accesses, "
+       "%lld swap sectors read, %lld written",
+       percent, faults * 1000 / (long long) access_cnt, reads, writes);
+}
+
+void
+test_main (void)
+{
+  int max_percent = 200;
+  int percent;
+
+  if (get_swap_disk_read_cnt () < 0)
+    {
+      msg ("no swap disk, measuring only what fits in memory");
+      max_percent = 50;
+    }
+  for (percent = 50; percent <= max_percent; percent += 50)
+    run (percent);
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# The numbers depend on the replacement policy, so only check
+# that every working set was measured.  Without a swap disk, only
+# the one that fits in memory can be.
+local ($_);
+my (%seen);
+my (@percents) = (50, 100, 150, 200);
+@percents = (50) if grep (/no swap disk/, @output);
+foreach (@output) {
+    my ($percent) = /^\(page-replace\) working set (\d+)%: \d+ faults per 1000 accesses, \d+ swap sectors read, \d+ written$/
+      or next;
+    $seen{$percent} = 1;
+}
+foreach my $percent (@percents) {
+    fail "Working set of $percent% was not measured.\n"
+      if !$seen{$percent};
+}
+pass;
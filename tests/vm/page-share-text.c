@@ -0,0 +1,34 @@
+/* Execs a second copy of this program while the first is still
+   running, so the second finds the first's code resident.  The
+   kernel must map the resident code frames into the second copy
+   instead of reading the executable again; page-share-text.ck
+   checks the count of shared pages that the kernel prints when it
+   powers off. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+int
+main (int argc, char *argv[])
+{
+  pid_t child;
+
+  test_name = "page-share-text";
+
+  if (argc > 1 && !strcmp (argv[1], "child"))
+    {
+      msg ("child runs the same code");
+      return 0;
+    }
+
+  msg ("begin");
+  child = fork ("page-share-text");
+  if (child == 0)
+    CHECK (exec ("page-share-text child") != -1,
+           "exec \"page-share-text child\"");
+  if (wait (child) != 0)
+    fail ("child exited with an error");
+  msg ("end");
+  return 0;
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(page-share-text) begin
+(page-share-text) child runs the same code
+(page-share-text) end
+EOF
+
+# The kernel prints how many pages were mapped from resident frames
+# when it powers off.  Only the child's code can have been.
+my ($stats) = grep (/^Frame cache:/, @output);
+fail "frame cache statistics not found\n" if !defined $stats;
+my ($shared) = $stats =~ /(\d+) pages shared$/;
+fail "frame cache statistics not understood\n" if !defined $shared;
+fail "child shared no code with its parent\n" if $shared == 0;
+pass;
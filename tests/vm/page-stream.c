@@ -0,0 +1,76 @@
+/* Page-replacement benchmark for scan resistance.  A child sorts
+   128 kB of data with child-qsort, which keeps its buffer hot on
+   the stack, while this process streams several times through a
+   2 MB buffer, reading large.txt into it with read() and touching
+   each page only once per pass.
+   Reports the page faults taken during the run; a policy that
+   lets the stream push out the sorter's pages takes many more.
+   For this test, Pintos memory size is 8MB. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK_SIZE (128 * 1024)
+#define STREAM_SIZE (2 * 1024 * 1024)
+#define STREAM_PASSES 4
+
+static unsigned char chunk[CHUNK_SIZE];
+static unsigned char stream[STREAM_SIZE];
+
+void
+test_main (void)
+{
+  struct arc4 arc4;
+  long long faults;
+  unsigned long sum = 0;
+  int handle, size, pass;
+  pid_t child;
+  size_t i;
+
+  /* Start the sorter on a chunk of random data. */
+  arc4_init (&arc4, "foobar", 6);
+  arc4_crypt (&arc4, chunk, sizeof chunk);
+  CHECK (create ("buf0", CHUNK_SIZE), "create \"buf0\"");
+  CHECK ((handle = open ("buf0")) > 1, "open \"buf0\"");
+  write (handle, chunk, sizeof chunk);
+  close (handle);
+
+  faults = get_page_fault_cnt ();
+  child = fork ("child-qsort");
+  if (child == 0)
+    CHECK ((child = exec ("child-qsort buf0")) != -1,
+           "exec \"child-qsort buf0\"");
+
+  /* Stream through the file meanwhile. */
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+  size = filesize (handle);
+  if (size > STREAM_SIZE)
+    size = STREAM_SIZE;
+  for (pass = 0; pass < STREAM_PASSES; pass++)
+    {
+      seek (handle, 0);
+      if (read (handle, stream, size) != size)
+        fail ("read \"large.txt\" failed on pass %d", pass);
+      for (i = 0; i < (size_t) size; i++)
+        sum += stream[i];
+    }
+  close (handle);
+
+  CHECK (wait (child) == 72, "wait for child-qsort");
+  faults = get_page_fault_cnt () - faults;
+
+  /* Verify that the chunk came back sorted. */
+  CHECK ((handle = open ("buf0")) > 1, "open \"buf0\"");
+  read (handle, chunk, sizeof chunk);
+  close (handle);
+  for (i = 1; i < sizeof chunk; i++)
+    if (chunk[i - 1] > chunk[i])
+      fail ("byte %zu of sorted chunk is out of order", i);
+
+  if (sum == 0)
+    fail ("streamed file reads as zeros");
+  msg ("streamed %d passes, %lld faults", STREAM_PASSES, faults);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The fault count depends on the replacement policy, so check
+# everything else exactly.
+s/, \d+ faults$/, N faults/ foreach @output;
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(page-stream) begin
+(page-stream) create "buf0"
+(page-stream) open "buf0"
+(page-stream) open "large.txt"
+(page-stream) wait for child-qsort
+(page-stream) open "buf0"
+(page-stream) streamed 4 passes, N faults
+(page-stream) end
+EOF
+pass;
@@ -0,0 +1,90 @@
+/* Registers an area with a userfault object and forks a child to
+   handle its faults: for each fault it reads, the child makes up
+   the page and hands it over with uffd_copy().  The parent touches
+   every page of the area, checks what it finds, and reports how
+   long a round trip to the handler took. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 32
+#define AREA ((char *) 0x10000000)
+
+static char page[PAGE_SIZE];
+static struct vmstat before, after;
+
+/* Fills PAGE with the contents the handler gives page IDX. */
+static void
+make_page (size_t idx)
+{
+  memset (page, 'a' + idx % 26, PAGE_SIZE);
+  page[0] = idx;
+}
+
+/* Returns the upper bound, in cycles, of the bucket of HIST that
+   holds its median. */
+static unsigned long long
+median (const long long *hist)
+{
+  long long total = 0, seen = 0;
+  int i;
+
+  for (i = 0; i < VMSTAT_BUCKETS; i++)
+    total += hist[i];
+  for (i = 0; i < VMSTAT_BUCKETS; i++)
+    {
+      seen += hist[i];
+      if (seen * 2 >= total)
+        break;
+    }
+  return (2ULL << i) - 1;
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  int fd;
+  size_t i;
+
+  CHECK ((fd = userfaultfd ()) > 1, "userfaultfd");
+  CHECK (uffd_register (fd, AREA, PAGE_CNT * PAGE_SIZE) == 0,
+         "register %d pages", PAGE_CNT);
+
+  child = fork ("handler");
+  if (child == 0)
+    {
+      struct uffd_msg m;
+
+      for (i = 0; i < PAGE_CNT; i++)
+        {
+          if (read (fd, &m, sizeof m) != sizeof m)
+            exit (1);
+          make_page (((char *) m.addr - AREA) / PAGE_SIZE);
+          if (uffd_copy (fd, m.addr, page, PAGE_SIZE) != PAGE_SIZE)
+            exit (2);
+        }
+      exit (0);
+    }
+
+  vmstat (VMSTAT_SELF, &before);
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      make_page (i);
+      if (memcmp (AREA + i * PAGE_SIZE, page, PAGE_SIZE))
+        fail ("page %zu does not hold what the handler gave it", i);
+    }
+  vmstat (VMSTAT_SELF, &after);
+  CHECK (wait (child) == 0, "handler filled every page");
+
+  if (after.events[VM_EV_USER_FAULT] - before.events[VM_EV_USER_FAULT]
+      != PAGE_CNT)
+    fail ("%lld faults forwarded, not %d",
+          after.events[VM_EV_USER_FAULT] - before.events[VM_EV_USER_FAULT],
+          PAGE_CNT);
+  msg ("%d faults forwarded, round trip p50 < %llu cycles", PAGE_CNT,
+       median (after.latency[VM_FAULT_USER]));
+}
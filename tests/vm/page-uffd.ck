@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# The round trip time depends on the machine, so check everything
+# else exactly.
+s/round trip p50 < \d+ cycles$/round trip p50 < N cycles/ foreach @output;
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(page-uffd) begin
+(page-uffd) userfaultfd
+(page-uffd) register 32 pages
+(page-uffd) handler filled every page
+(page-uffd) 32 faults forwarded, round trip p50 < N cycles
+(page-uffd) end
+EOF
+pass;
@@ -0,0 +1,65 @@
+/* Reads the virtual memory statistics with vmstat() around page
+   faults of each kind: first touches of lazily loaded pages, and a
+   child's writes to pages it shares with its parent after fork().
+   Checks that the counters and the latency histograms moved. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 16
+
+static char buf[PAGE_CNT][PAGE_SIZE];
+static struct vmstat before, after;
+
+/* Returns the number of faults in histogram HIST. */
+static long long
+histogram_total (const long long *hist)
+{
+  long long total = 0;
+  int i;
+
+  for (i = 0; i < VMSTAT_BUCKETS; i++)
+    total += hist[i];
+  return total;
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  CHECK (vmstat (VMSTAT_SELF, &before) == 0, "vmstat self");
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i][0] = i;
+  CHECK (vmstat (VMSTAT_SELF, &after) == 0, "vmstat self");
+  if (after.events[VM_EV_MINOR_FAULT] + after.events[VM_EV_MAJOR_FAULT]
+      <= before.events[VM_EV_MINOR_FAULT] + before.events[VM_EV_MAJOR_FAULT])
+    fail ("touching %d new pages took no faults", PAGE_CNT);
+  if (histogram_total (after.latency[VM_FAULT_MINOR])
+      + histogram_total (after.latency[VM_FAULT_MAJOR]) == 0)
+    fail ("fault latency histograms are empty");
+  msg ("faults counted");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      /* Writes to pages shared with the parent are copy-on-write
+         faults of the child's. */
+      vmstat (VMSTAT_SELF, &before);
+      for (i = 0; i < PAGE_CNT; i++)
+        buf[i][1] = i;
+      vmstat (VMSTAT_SELF, &after);
+      exit (after.events[VM_EV_COW_FAULT] > before.events[VM_EV_COW_FAULT]
+            && histogram_total (after.latency[VM_FAULT_COW]) > 0 ? 0 : 1);
+    }
+  CHECK (wait (child) == 0, "child counted copy-on-write faults");
+
+  CHECK (vmstat (VMSTAT_GLOBAL, &after) == 0, "vmstat global");
+  if (after.events[VM_EV_COW_FAULT] == 0)
+    fail ("system counted no copy-on-write faults");
+  CHECK (vmstat (2, &after) == -1, "vmstat with bad counters");
+}
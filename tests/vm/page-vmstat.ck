@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-vmstat) begin
+(page-vmstat) vmstat self
+(page-vmstat) vmstat self
+(page-vmstat) faults counted
+(page-vmstat) child counted copy-on-write faults
+(page-vmstat) vmstat global
+(page-vmstat) vmstat with bad counters
+(page-vmstat) end
+EOF
+pass;
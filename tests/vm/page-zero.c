@@ -0,0 +1,38 @@
+/* Reads every page of an array much bigger than memory, then
+   writes to a few of its pages and reads everything back.  Pages
+   that are only read share the zero frame, so this needs neither
+   that much memory nor swap space for it. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (16 * 1024 * 1024)
+#define STRIDE (SIZE / 8)
+
+static char buf[SIZE];
+
+/* Returns the byte expected at offset OFS after the writes. */
+static char
+expected (size_t ofs)
+{
+  return ofs % STRIDE == 0 ? 'a' + ofs / STRIDE : 0;
+}
+
+void
+test_main (void)
+{
+  size_t ofs;
+
+  for (ofs = 0; ofs < SIZE; ofs += 4096)
+    if (buf[ofs] != 0)
+      fail ("byte %zu is %d, not 0", ofs, buf[ofs]);
+  msg ("read %d MB of zeros", SIZE / 1024 / 1024);
+
+  for (ofs = 0; ofs < SIZE; ofs += STRIDE)
+    buf[ofs] = expected (ofs);
+  for (ofs = 0; ofs < SIZE; ofs += 4096)
+    if (buf[ofs] != expected (ofs))
+      fail ("byte %zu is %d, not %d", ofs, buf[ofs], expected (ofs));
+  msg ("wrote %d pages and read them back", SIZE / STRIDE);
+}
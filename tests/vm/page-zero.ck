@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-zero) begin
+(page-zero) read 16 MB of zeros
+(page-zero) wrote 8 pages and read them back
+(page-zero) end
+EOF
+pass;
@@ -0,0 +1,50 @@
+/* Fills an array bigger than memory, most of it with data that
+   compresses well and every eighth page with data that does not,
+   then checks it twice.  Runs with the compressed swap pool on, so
+   pages are swapped both to the pool and to disk, and the pool
+   writes its oldest pages to disk as it fills up.
+   For this test, Pintos memory size is 8MB. */
+
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 1536
+#define PASSES 2
+
+static uint8_t buf[PAGE_CNT][PAGE_SIZE];
+
+/* Returns the byte expected at offset OFS of page PAGE. */
+static uint8_t
+expected (size_t page, size_t ofs)
+{
+  if (page % 8 == 7)
+    {
+      uint32_t x = (page * PAGE_SIZE + ofs) * 2654435761u;
+      return (x ^ (x >> 15)) >> 8;
+    }
+  return ofs < 16 ? page + ofs : ofs / 64;
+}
+
+void
+test_main (void)
+{
+  size_t page, ofs;
+  int pass;
+
+  for (page = 0; page < PAGE_CNT; page++)
+    for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+      buf[page][ofs] = expected (page, ofs);
+  msg ("filled %d pages", PAGE_CNT);
+
+  for (pass = 0; pass < PASSES; pass++)
+    {
+      for (page = 0; page < PAGE_CNT; page++)
+        for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+          if (buf[page][ofs] != expected (page, ofs))
+            fail ("page %zu, byte %zu is %d, not %d", page, ofs,
+                  buf[page][ofs], expected (page, ofs));
+      msg ("checked them, pass %d", pass);
+    }
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-zswap) begin
+(page-zswap) filled 1536 pages
+(page-zswap) checked them, pass 0
+(page-zswap) checked them, pass 1
+(page-zswap) end
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Recurses deep enough to grow the stack by about half a megabyte,
+   touching every byte of a 1 kB local array in each call, and
+   checks the result.  Reports the page faults taken per megabyte of
+   stack; growing the stack a region at a time, with prefaulting,
+   takes fewer than one fault per page. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FRAME_SIZE 1024
+#define DEPTH 480
+
+/* Fills a local array with DEPTH and returns the sum of the first
+   byte of the arrays of this call and all deeper ones. */
+static long
+recurse (int depth)
+{
+  volatile char frame[FRAME_SIZE];
+  int i;
+
+  for (i = 0; i < FRAME_SIZE; i++)
+    frame[i] = depth;
+  if (depth == 0)
+    return frame[0];
+  return recurse (depth - 1) + frame[FRAME_SIZE - 1];
+}
+
+void
+test_main (void)
+{
+  long long faults = get_page_fault_cnt ();
+  long expected = 0;
+  long sum;
+  int depth;
+
+  sum = recurse (DEPTH);
+  faults = get_page_fault_cnt () - faults;
+
+  for (depth = 0; depth <= DEPTH; depth++)
+    expected += (char) depth;
+  if (sum != expected)
+    fail ("sum is %ld, not %ld", sum, expected);
+  msg ("recursed %d calls deep, %lld faults per MB of stack", DEPTH,
+       faults * 1024 / (DEPTH * FRAME_SIZE / 1024));
+}
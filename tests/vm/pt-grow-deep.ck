@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+
+# With -stack-prefault=4 each growth maps five pages, so the stack
+# should take well under one fault per page, that is, 256 per MB.
+my ($line) = grep (/faults per MB of stack$/, @output);
+fail "fault count not found\n" if !defined $line;
+my ($faults) = $line =~ /(\d+) faults per MB of stack$/;
+fail "$faults faults per MB of stack, expected fewer than 128\n"
+  if $faults >= 128;
+
+# The fault count depends on how the stack grows, so check
+# everything else exactly.
+s/, \d+ faults per MB of stack$/, N faults per MB of stack/ foreach @output;
+compare_output ("run", IGNORE_EXIT_CODES => 1, \@output, [<<'EOF']);
+(pt-grow-deep) begin
+(pt-grow-deep) recursed 480 calls deep, N faults per MB of stack
+(pt-grow-deep) end
+EOF
+pass;
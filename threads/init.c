@@ -13,14 +13,17 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "intrinsic.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
+#include "threads/memtrack.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -31,6 +34,7 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -41,6 +45,9 @@
 /* Page-map-level-4 with kernel mappings only. */
 uint64_t *base_pml4;
 
+/* CR0 bit that makes supervisor writes respect read-only pages. */
+#define CR0_WP 0x00010000
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -86,6 +93,7 @@ main (void) {
 	mem_end = palloc_init ();
 	malloc_init ();
 	paging_init (mem_end);
+	vmalloc_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -152,19 +160,36 @@ paging_init (uint64_t mem_end) {
 	extern char start, _end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	// Whole 2 MB chunks that do not hold kernel text are mapped
+	// with huge pages, to save TLB entries and page tables.
+	for (uint64_t pa = 0; pa < mem_end; ) {
 		uint64_t va = (uint64_t) ptov(pa);
 
 		perm = PTE_P | PTE_W;
+		if ((pa & HUGE_PGMASK) == 0 && pa + HUGE_PGSIZE <= mem_end
+				&& (va + HUGE_PGSIZE <= (uint64_t) &start
+					|| va >= (uint64_t) &_end_kernel_text)) {
+			if ((pte = pml4e_walk_pde (pml4, va, 1)) != NULL)
+				*pte = pa | perm | PTE_PS;
+			pa += HUGE_PGSIZE;
+			continue;
+		}
+
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
 		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
 			*pte = pa | perm;
+		pa += PGSIZE;
 	}
 
 	// reload cr3
+	pml4_enable_pcid ();
 	pml4_activate(0);
+
+	// Make the kernel honor read-only user pages too, so that its
+	// writes to a copy-on-write page fault like the user's would.
+	lcr0 (rcr0 () | CR0_WP);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -221,11 +246,29 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-mt"))
+			memtrack_enabled = true;
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-wm-low"))
+			vm_low_wmark = atoi (value);
+		else if (!strcmp (name, "-wm-high"))
+			vm_high_wmark = atoi (value);
+		else if (!strcmp (name, "-ksm"))
+			vm_ksm_pages = atoi (value);
+		else if (!strcmp (name, "-zswap"))
+			zswap_pool_pages = atoi (value);
+		else if (!strcmp (name, "-stack-max"))
+			vm_stack_pages = atoi (value);
+		else if (!strcmp (name, "-stack-prefault"))
+			vm_stack_prefault = atoi (value);
+		else if (!strcmp (name, "-populate"))
+			vm_populate_progs = value;
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -326,8 +369,18 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -mt                Track memory use per allocation call site.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -wm-low=COUNT      Wake the page-out daemon below COUNT free pages.\n"
+			"  -wm-high=COUNT     Let it sleep again at COUNT free pages.\n"
+			"  -ksm=COUNT         Merge identical pages, checking COUNT frames per scan.\n"
+			"  -zswap=COUNT       Keep swapped pages compressed in COUNT pages of RAM.\n"
+			"  -stack-max=COUNT   Let user stacks grow to COUNT pages.\n"
+			"  -stack-prefault=COUNT  Map COUNT more pages as a stack grows.\n"
+			"  -populate=PROGS    Load programs PROGS (comma-separated, or all) on exec.\n"
 #endif
 			);
 	power_off ();
@@ -362,4 +415,9 @@ print_stats (void) {
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+#endif
+	palloc_print_stats ();
+	memtrack_print_stats ();
 }
@@ -5,9 +5,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/memtrack.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
@@ -30,9 +32,12 @@
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   descriptor.  We handle those by allocating whole pages and
+   sticking the allocation size at the beginning of the
+   allocated block's arena header.  Multi-page blocks come from
+   vmalloc(), which does not need physically contiguous memory;
+   we fall back to contiguous pages from the page allocator only
+   before vmalloc_init() or when its region is exhausted. */
 
 /* Descriptor. */
 struct desc {
@@ -57,12 +62,21 @@ struct block {
 	struct list_elem free_elem; /* Free list element. */
 };
 
+/* Prepended to every block when memtrack is enabled. */
+struct tag {
+	memtrack_site_t site;       /* Call site that allocated it. */
+	size_t size;                /* Requested size in bytes. */
+};
+
 /* Our set of descriptors. */
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *malloc_at (size_t size, const void *site);
+static void *malloc_block (size_t size);
+static void free_block (void *p);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -83,6 +97,29 @@ malloc_init (void) {
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) {
+	return malloc_at (size, __builtin_return_address (0));
+}
+
+/* Like malloc(), but charges the block to call site SITE. */
+static void *
+malloc_at (size_t size, const void *site) {
+	struct tag *t;
+
+	if (!memtrack_enabled || size == 0)
+		return malloc_block (size);
+
+	t = malloc_block (size + sizeof *t);
+	if (t == NULL)
+		return NULL;
+	t->site = memtrack_alloc (site, size);
+	t->size = size;
+	return t + 1;
+}
+
+/* Obtains and returns a new untagged block of at least SIZE
+   bytes. */
+static void *
+malloc_block (size_t size) {
 	struct desc *d;
 	struct block *b;
 	struct arena *a;
@@ -100,7 +137,9 @@ malloc (size_t size) {
 		/* SIZE is too big for any descriptor.
 		   Allocate enough pages to hold SIZE plus an arena. */
 		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-		a = palloc_get_multiple (0, page_cnt);
+		a = page_cnt > 1 ? vmalloc (page_cnt) : NULL;
+		if (a == NULL)
+			a = palloc_get_multiple (0, page_cnt);
 		if (a == NULL)
 			return NULL;
 
@@ -156,7 +195,7 @@ calloc (size_t a, size_t b) {
 		return NULL;
 
 	/* Allocate and zero memory. */
-	p = malloc (size);
+	p = malloc_at (size, __builtin_return_address (0));
 	if (p != NULL)
 		memset (p, 0, size);
 
@@ -166,6 +205,9 @@ calloc (size_t a, size_t b) {
 /* Returns the number of bytes allocated for BLOCK. */
 static size_t
 block_size (void *block) {
+	if (memtrack_enabled)
+		return ((struct tag *) block - 1)->size;
+
 	struct block *b = block;
 	struct arena *a = block_to_arena (b);
 	struct desc *d = a->desc;
@@ -185,7 +227,7 @@ realloc (void *old_block, size_t new_size) {
 		free (old_block);
 		return NULL;
 	} else {
-		void *new_block = malloc (new_size);
+		void *new_block = malloc_at (new_size, __builtin_return_address (0));
 		if (old_block != NULL && new_block != NULL) {
 			size_t old_size = block_size (old_block);
 			size_t min_size = new_size < old_size ? new_size : old_size;
@@ -200,6 +242,18 @@ realloc (void *old_block, size_t new_size) {
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) {
+	if (p != NULL && memtrack_enabled) {
+		struct tag *t = (struct tag *) p - 1;
+
+		memtrack_free (t->site, t->size);
+		p = t;
+	}
+	free_block (p);
+}
+
+/* Frees untagged block P. */
+static void
+free_block (void *p) {
 	if (p != NULL) {
 		struct block *b = p;
 		struct arena *a = block_to_arena (b);
@@ -233,7 +287,10 @@ free (void *p) {
 			lock_release (&d->lock);
 		} else {
 			/* It's a big block.  Free its pages. */
-			palloc_free_multiple (a, a->free_cnt);
+			if (is_vmalloc_vaddr (a))
+				vfree (a, a->free_cnt);
+			else
+				palloc_free_multiple (a, a->free_cnt);
 			return;
 		}
 	}
@@ -0,0 +1,119 @@
+#include "threads/memtrack.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+
+/* Allocator instrumentation.
+
+   When enabled with -mt, malloc() and the page allocator report
+   every allocation and free here, keyed by the return address of
+   the caller.  We keep live bytes and allocation counts per call
+   site, and print the sites that still hold memory at power off.
+   Addresses can be turned into function names with the
+   `backtrace' utility.
+
+   The table is a fixed-size open-addressed hash, because it must
+   work before malloc() itself is usable.  Slot 0 collects every
+   site that does not fit. */
+
+/* A call site. */
+struct memtrack_site {
+	const void *site;           /* Return address of the caller. */
+	size_t live_bytes;          /* Bytes currently allocated. */
+	size_t live_cnt;            /* Allocations currently live. */
+	size_t peak_bytes;          /* High-water mark of live_bytes. */
+	size_t alloc_cnt;           /* Total allocations. */
+	size_t free_cnt;            /* Total frees. */
+};
+
+#define MEMTRACK_SITES 512
+
+bool memtrack_enabled;
+static struct memtrack_site sites[MEMTRACK_SITES];
+
+/* Returns the slot for SITE, claiming a new one if needed. */
+static memtrack_site_t
+lookup_site (const void *site) {
+	size_t start = ((uintptr_t) site >> 2) % (MEMTRACK_SITES - 1) + 1;
+	size_t i = start;
+
+	do {
+		if (sites[i].site == site)
+			return i;
+		if (sites[i].site == NULL) {
+			sites[i].site = site;
+			return i;
+		}
+		i = i + 1 < MEMTRACK_SITES ? i + 1 : 1;
+	} while (i != start);
+
+	return 0;
+}
+
+/* Records an allocation of BYTES bytes made from SITE.  Returns
+   the slot to pass to memtrack_free() when it is released. */
+memtrack_site_t
+memtrack_alloc (const void *site, size_t bytes) {
+	enum intr_level old_level = intr_disable ();
+	memtrack_site_t idx = lookup_site (site);
+	struct memtrack_site *s = &sites[idx];
+
+	s->live_bytes += bytes;
+	s->live_cnt++;
+	s->alloc_cnt++;
+	if (s->live_bytes > s->peak_bytes)
+		s->peak_bytes = s->live_bytes;
+	intr_set_level (old_level);
+	return idx;
+}
+
+/* Records that BYTES bytes allocated from slot IDX were freed. */
+void
+memtrack_free (memtrack_site_t idx, size_t bytes) {
+	enum intr_level old_level = intr_disable ();
+	struct memtrack_site *s = &sites[idx];
+
+	ASSERT (idx < MEMTRACK_SITES);
+	ASSERT (s->live_bytes >= bytes);
+	s->live_bytes -= bytes;
+	s->live_cnt--;
+	s->free_cnt++;
+	intr_set_level (old_level);
+}
+
+/* Prints every call site that still holds memory, largest
+   first. */
+void
+memtrack_print_stats (void) {
+	static bool printed[MEMTRACK_SITES];
+	int64_t secs = timer_ticks () / TIMER_FREQ;
+	size_t total = 0;
+	size_t i;
+
+	if (!memtrack_enabled)
+		return;
+
+	for (i = 0; i < MEMTRACK_SITES; i++)
+		total += sites[i].live_bytes;
+	printf ("Memtrack: %zu bytes live\n", total);
+
+	for (;;) {
+		struct memtrack_site *max = NULL;
+
+		for (i = 0; i < MEMTRACK_SITES; i++)
+			if (!printed[i] && sites[i].live_bytes > 0
+					&& (max == NULL || sites[i].live_bytes > max->live_bytes))
+				max = &sites[i];
+		if (max == NULL)
+			break;
+		printed[max - sites] = true;
+
+		printf ("  %p: %zu bytes in %zu blocks (peak %zu), "
+				"%zu allocs (%lld/s), %zu frees\n",
+				max->site, max->live_bytes, max->live_cnt, max->peak_bytes,
+				max->alloc_cnt, secs > 0 ? (long long) (max->alloc_cnt / secs)
+				: (long long) max->alloc_cnt, max->free_cnt);
+	}
+}
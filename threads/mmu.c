@@ -8,6 +8,58 @@
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Process-context identifiers.
+
+   With CR4.PCIDE set, the low 12 bits of CR3 tag every TLB entry
+   with the address space that created it, so switching pml4s no
+   longer has to throw away the TLB.  We derive each pml4's PCID
+   from its address, and remember which pml4 currently owns the
+   entries tagged with each PCID.  Activating a pml4 that does not
+   own its PCID (a collision, a recycled pml4 page, or an owner
+   whose entries went stale) loads CR3 without the no-flush bit,
+   which drops exactly that PCID's entries.
+
+   Kernel mappings that change after boot are global (PTE_G), so
+   one TLB entry serves every PCID, and invlpg drops it for all of
+   them at once. */
+#define CPUID_PCID (1 << 17)          /* CPUID.01H:ECX PCID support. */
+#define CPUID_PGE (1 << 13)           /* CPUID.01H:EDX global page support. */
+#define CR4_PGE (1 << 7)              /* CR4 global page enable. */
+#define CR4_PCIDE (1 << 17)           /* CR4 PCID enable. */
+#define CR3_NOFLUSH (1ULL << 63)      /* Keep TLB entries on CR3 load. */
+#define PCID_CNT 4096
+
+static bool pcid_enabled;
+static bool pge_enabled;
+static uint64_t *pcid_owner[PCID_CNT];
+
+/* Returns the PCID used for PML4.  PCID 0 is reserved for the
+   kernel-only base_pml4. */
+static uint16_t
+pcid_of (uint64_t *pml4) {
+	if (pml4 == base_pml4)
+		return 0;
+	return pg_no (pml4) % (PCID_CNT - 1) + 1;
+}
+
+/* Returns true if PML4 is loaded in CR3. */
+static bool
+is_active (uint64_t *pml4) {
+	return PTE_ADDR (rcr3 ()) == vtop (pml4);
+}
+
+/* Invalidates any TLB entry for VA cached from PML4.  If PML4 is
+   not active, we cannot reach its entries with invlpg; instead we
+   drop its ownership of its PCID, which makes the next
+   pml4_activate() flush them. */
+static void
+tlb_invalidate (uint64_t *pml4, const void *va) {
+	if (is_active (pml4))
+		invlpg ((uint64_t) va);
+	else if (pcid_enabled && pcid_owner[pcid_of (pml4)] == pml4)
+		pcid_owner[pcid_of (pml4)] = NULL;
+}
+
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
@@ -23,6 +75,9 @@ pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 			} else
 				return NULL;
 		}
+		/* A huge page has no page table; its PDE is the leaf. */
+		if (pdp[idx] & PTE_PS)
+			return &pdp[idx];
 		return (uint64_t *) ptov (PTE_ADDR (pdp[idx]) + 8 * PTX (va));
 	}
 	return NULL;
@@ -88,6 +143,35 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	return pte;
 }
 
+/* Returns the next-level table that ENTRY points to, creating an
+ * empty one if ENTRY is not present and CREATE is true. */
+static uint64_t *
+next_level (uint64_t *entry, int create) {
+	if (!(*entry & PTE_P)) {
+		uint64_t *new_page;
+
+		if (!create || (new_page = palloc_get_page (PAL_ZERO)) == NULL)
+			return NULL;
+		*entry = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+	}
+	return ptov (PTE_ADDR (*entry));
+}
+
+/* Returns the address of the page directory entry for virtual
+ * address VA in page map level 4, pml4.  This is the entry that
+ * maps a 2 MB huge page.  Missing upper levels are created if
+ * CREATE is true; otherwise a null pointer is returned. */
+uint64_t *
+pml4e_walk_pde (uint64_t *pml4e, const uint64_t va, int create) {
+	uint64_t *pdpe, *pde;
+
+	if (pml4e == NULL
+			|| (pdpe = next_level (&pml4e[PML4 (va)], create)) == NULL
+			|| (pde = next_level (&pdpe[PDPE (va)], create)) == NULL)
+		return NULL;
+	return &pde[PDX (va)];
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
@@ -122,10 +206,17 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
-			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
+		if (((uint64_t) pte) & PTE_P) {
+			if (pdp[i] & PTE_PS) {
+				void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+									 ((uint64_t) pdp_index << PDPESHIFT) |
+									 ((uint64_t) i << PDXSHIFT));
+				if (!func (&pdp[i], va, aux))
+					return false;
+			} else if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
+		}
 	}
 	return true;
 }
@@ -196,14 +287,77 @@ pml4_destroy (uint64_t *pml4) {
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
 		pdpe_destroy ((void *) PTE_ADDR (pdpe));
+
+	/* A new pml4 may reuse this page; it must not inherit our
+	 * TLB entries. */
+	if (pcid_owner[pcid_of (pml4)] == pml4)
+		pcid_owner[pcid_of (pml4)] = NULL;
 	palloc_free_page ((void *) pml4);
 }
 
+/* Turns on global pages and PCID-tagged TLB entries if the CPU
+ * supports them.  Must be called while CR3 holds PCID 0. */
+void
+pml4_enable_pcid (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (edx & CPUID_PGE) {
+		lcr4 (rcr4 () | CR4_PGE);
+		pge_enabled = true;
+	}
+	if (ecx & CPUID_PCID) {
+		lcr4 (rcr4 () | CR4_PCIDE);
+		pcid_enabled = true;
+	}
+}
+
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  Reloading the active pml4 is a no-op, and with PCIDs
+ * the TLB entries of the new address space survive the switch. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	uint64_t cr3;
+	uint16_t pcid;
+
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+
+	if (!pcid_enabled) {
+		if (!is_active (pml4))
+			lcr3 (vtop (pml4));
+		return;
+	}
+
+	pcid = pcid_of (pml4);
+	cr3 = vtop (pml4) | pcid;
+	if (pcid_owner[pcid] == pml4) {
+		if (rcr3 () == cr3)
+			return;
+		cr3 |= CR3_NOFLUSH;
+	} else
+		pcid_owner[pcid] = pml4;
+	lcr3 (cr3);
+}
+
+/* Invalidates the kernel mappings of the PAGE_CNT pages starting
+ * at VA in every address space.  Kernel mappings are shared by all
+ * pml4s, so entries for them may be cached under any PCID.  If
+ * they were mapped global, invlpg drops them under every PCID;
+ * otherwise every other address space must flush on its next
+ * activation. */
+void
+pml4_invalidate_kernel (const void *va, size_t page_cnt) {
+	ASSERT (is_kernel_vaddr (va));
+
+	for (size_t i = 0; i < page_cnt; i++)
+		invlpg ((uint64_t) va + i * PGSIZE);
+	if (pcid_enabled && !pge_enabled) {
+		uint16_t active = rcr3 () & PGMASK;
+		for (int i = 0; i < PCID_CNT; i++)
+			if (i != active)
+				pcid_owner[i] = NULL;
+	}
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -238,8 +392,13 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 1);
 
-	if (pte)
+	if (pte) {
+		bool was_present = (*pte & PTE_P) != 0;
+
 		*pte = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		if (was_present)
+			tlb_invalidate (pml4, upage);
+	}
 	return pte != NULL;
 }
 
@@ -257,11 +416,145 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_invalidate (pml4, upage);
 	}
 }
 
+/* Range operations.
+
+   The functions below change PAGE_CNT consecutive pages at once.
+   Rather than walking all four levels from the root for every
+   page, they walk once per page table and then step through its
+   consecutive entries, and they flush the TLB once at the end. */
+
+/* Above this many pages, reloading CR3 is cheaper than invlpg. */
+#define TLB_FLUSH_THRESHOLD 32
+
+/* Returns the leaf entry for VA, like pml4e_walk(), and stores in
+ * *RUN the number of pages from VA to the end of the page table
+ * that holds it. */
+static uint64_t *
+walk_run (uint64_t *pml4, uint64_t va, int create, size_t *run) {
+	*run = PGSIZE / sizeof (uint64_t) - PTX (va);
+	return pml4e_walk (pml4, va, create);
+}
+
+/* Invalidates the TLB entries for the PAGE_CNT pages starting at
+ * UPAGE in PML4. */
+static void
+tlb_invalidate_range (uint64_t *pml4, void *upage, size_t page_cnt) {
+	if (!is_active (pml4))
+		tlb_invalidate (pml4, upage);
+	else if (page_cnt > TLB_FLUSH_THRESHOLD)
+		lcr3 (rcr3 ());   /* Flushes the active PCID only. */
+	else
+		for (size_t i = 0; i < page_cnt; i++)
+			invlpg ((uint64_t) upage + i * PGSIZE);
+}
+
+/* Maps the PAGE_CNT user virtual pages starting at UPAGE to the
+ * frames KPAGES[0] through KPAGES[PAGE_CNT - 1], like that many
+ * calls to pml4_set_page().  None of the pages may be mapped yet.
+ * Returns true if successful.  On failure, because a page was
+ * already mapped or memory allocation failed, nothing is left
+ * mapped. */
+bool
+pml4_map_range (uint64_t *pml4, void *upage, void **kpages,
+		size_t page_cnt, bool rw) {
+	size_t done = 0;
+
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr ((uint8_t *) upage + page_cnt * PGSIZE - 1));
+	ASSERT (pml4 != base_pml4);
+
+	while (done < page_cnt) {
+		uint64_t va = (uint64_t) upage + done * PGSIZE;
+		size_t run;
+		uint64_t *pte = walk_run (pml4, va, 1, &run);
+
+		if (pte == NULL)
+			goto fail;
+		for (; run > 0 && done < page_cnt; run--, done++, pte++) {
+			if (*pte & PTE_P)
+				goto fail;
+			ASSERT (pg_ofs (kpages[done]) == 0);
+			*pte = vtop (kpages[done]) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		}
+	}
+	return true;
+
+fail:
+	pml4_unmap_range (pml4, upage, done);
+	return false;
+}
+
+/* Marks the PAGE_CNT user virtual pages starting at UPAGE "not
+ * present" in PML4, like that many calls to pml4_clear_page().
+ * The pages need not be mapped. */
+void
+pml4_unmap_range (uint64_t *pml4, void *upage, size_t page_cnt) {
+	size_t done = 0;
+	bool changed = false;
+
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (upage));
+
+	while (done < page_cnt) {
+		uint64_t va = (uint64_t) upage + done * PGSIZE;
+		size_t run;
+		uint64_t *pte = walk_run (pml4, va, 0, &run);
+
+		if (run > page_cnt - done)
+			run = page_cnt - done;
+		if (pte != NULL)
+			for (size_t i = 0; i < run; i++) {
+				changed |= (pte[i] & PTE_P) != 0;
+				pte[i] &= ~PTE_P;
+			}
+		done += run;
+	}
+	if (changed)
+		tlb_invalidate_range (pml4, upage, page_cnt);
+}
+
+/* Sets or clears the writable bit of leaf entry PTE, if present.
+ * Returns true if the entry changed. */
+static bool
+protect_entry (uint64_t *pte, bool rw) {
+	uint64_t old = *pte;
+
+	if (!(old & PTE_P))
+		return false;
+	*pte = rw ? old | PTE_W : old & ~(uint64_t) PTE_W;
+	return *pte != old;
+}
+
+/* Makes the mapped pages among the PAGE_CNT user virtual pages
+ * starting at UPAGE writable if RW is true, read-only otherwise. */
+void
+pml4_protect_range (uint64_t *pml4, void *upage, size_t page_cnt, bool rw) {
+	size_t done = 0;
+	bool changed = false;
+
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (upage));
+
+	while (done < page_cnt) {
+		uint64_t va = (uint64_t) upage + done * PGSIZE;
+		size_t run;
+		uint64_t *pte = walk_run (pml4, va, 0, &run);
+
+		if (run > page_cnt - done)
+			run = page_cnt - done;
+		if (pte != NULL)
+			for (size_t i = 0; i < run; i++)
+				changed |= protect_entry (&pte[i], rw);
+		done += run;
+	}
+	if (changed)
+		tlb_invalidate_range (pml4, upage, page_cnt);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
  * that is, if the page has been modified since the PTE was
  * installed.
@@ -281,10 +574,9 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		if (dirty)
 			*pte |= PTE_D;
 		else
-			*pte &= ~(uint32_t) PTE_D;
+			*pte &= ~(uint64_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, vpage);
 	}
 }
 
@@ -299,7 +591,13 @@ pml4_is_accessed (uint64_t *pml4, const void *vpage) {
 }
 
 /* Sets the accessed bit to ACCESSED in the PTE for virtual page
-   VPAGE in PD. */
+   VPAGE in PD.
+
+   A stale TLB entry only keeps the CPU from setting the bit again
+   until the entry is evicted, which at worst makes the page look
+   colder than it is.  So when PML4 is not active we leave its
+   PCID alone rather than flush the whole address space every
+   time the page scanner ages one of its pages. */
 void
 pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
@@ -307,9 +605,9 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		if (accessed)
 			*pte |= PTE_A;
 		else
-			*pte &= ~(uint32_t) PTE_A;
+			*pte &= ~(uint64_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
+		if (is_active (pml4))
 			invlpg ((uint64_t) vpage);
 	}
 }
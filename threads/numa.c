@@ -0,0 +1,311 @@
+#include "threads/numa.h"
+#include <debug.h>
+#include <intrinsic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/vaddr.h"
+
+/* NUMA topology.
+
+   Under QEMU's -numa options, the firmware describes which memory
+   and which CPUs belong to each node in the ACPI System Resource
+   Affinity Table (SRAT).  We find it through the RSDP and the RSDT
+   or XSDT, and record the span of physical memory of each node
+   and the node of the CPU we run on, so that the page allocator
+   can hand out memory close to it.
+
+   This runs from palloc_init(), before the page allocator exists.
+   The tables usually sit in ACPI reclaimable memory, which the
+   allocator then takes over, so everything needed later is copied
+   out here.  Only the memory that start.S maps at boot is
+   readable yet.
+
+   Without an SRAT, or with one we cannot use, there is a single
+   node that covers all memory. */
+
+/* Physical memory that start.S maps at boot. */
+#define BOOT_MAPPED (256 * 1024 * 1024)
+
+/* Root System Description Pointer. */
+struct rsdp {
+	char signature[8];          /* "RSD PTR ". */
+	uint8_t checksum;           /* Of the first 20 bytes. */
+	char oem_id[6];
+	uint8_t revision;           /* 0 for ACPI 1.0, 2 for later. */
+	uint32_t rsdt;              /* Physical address of the RSDT. */
+	uint32_t length;            /* From here on, revision 2 only. */
+	uint64_t xsdt;              /* Physical address of the XSDT. */
+	uint8_t xchecksum;
+	uint8_t reserved[3];
+} __attribute__((packed));
+
+/* Header of every ACPI table. */
+struct sdt_header {
+	char signature[4];
+	uint32_t length;            /* Of the whole table. */
+	uint8_t revision;
+	uint8_t checksum;           /* Of the whole table. */
+	char oem_id[6];
+	char oem_table_id[8];
+	uint32_t oem_revision;
+	uint32_t creator_id;
+	uint32_t creator_revision;
+} __attribute__((packed));
+
+/* SRAT entries follow its header and 12 reserved bytes. */
+#define SRAT_ENTRIES (sizeof (struct sdt_header) + 12)
+
+/* SRAT entry types. */
+#define SRAT_CPU 0                  /* Processor Local APIC affinity. */
+#define SRAT_MEMORY 1               /* Memory affinity. */
+#define SRAT_X2APIC 2               /* Processor Local x2APIC affinity. */
+
+/* Flags of SRAT entries. */
+#define SRAT_ENABLED 0x1            /* Entry is in use. */
+#define SRAT_HOTPLUG 0x2            /* Memory may be plugged in later. */
+
+/* Processor Local APIC affinity. */
+struct srat_cpu {
+	uint8_t type, length;
+	uint8_t domain_lo;          /* Bits 0...7 of the domain. */
+	uint8_t apic_id;
+	uint32_t flags;
+	uint8_t sapic_eid;
+	uint8_t domain_hi[3];       /* Bits 8...31 of the domain. */
+	uint32_t clock_domain;
+} __attribute__((packed));
+
+/* Memory affinity. */
+struct srat_memory {
+	uint8_t type, length;
+	uint32_t domain;
+	uint16_t reserved1;
+	uint64_t base;
+	uint64_t size;
+	uint32_t reserved2;
+	uint32_t flags;
+	uint64_t reserved3;
+} __attribute__((packed));
+
+/* Processor Local x2APIC affinity. */
+struct srat_x2apic {
+	uint8_t type, length;
+	uint16_t reserved1;
+	uint32_t domain;
+	uint32_t x2apic_id;
+	uint32_t flags;
+	uint32_t clock_domain;
+	uint32_t reserved2;
+} __attribute__((packed));
+
+struct numa_node numa_nodes[NUMA_MAX_NODES];
+unsigned numa_node_cnt;
+
+/* Node of the CPU.  Pintos runs on one CPU, so it is looked up
+   once. */
+static unsigned cpu_node;
+
+static const struct sdt_header *find_table (const char *signature);
+static void parse_srat (const struct sdt_header *);
+
+/* Reads the NUMA topology from the SRAT, if there is one. */
+void
+numa_init (void) {
+	const struct sdt_header *srat = find_table ("SRAT");
+
+	numa_node_cnt = 0;
+	if (srat != NULL)
+		parse_srat (srat);
+
+	if (numa_node_cnt <= 1) {
+		numa_node_cnt = 1;
+		numa_nodes[0].start = 0;
+		numa_nodes[0].end = UINT64_MAX;
+		cpu_node = 0;
+	}
+}
+
+/* Returns the node that physical address PA belongs to, or node 0
+   if no node claims it. */
+unsigned
+numa_node_of (uint64_t pa) {
+	unsigned node;
+
+	for (node = 0; node < numa_node_cnt; node++)
+		if (pa >= numa_nodes[node].start && pa < numa_nodes[node].end)
+			return node;
+	return 0;
+}
+
+/* Returns the node of the CPU we are running on. */
+unsigned
+numa_current_node (void) {
+	return cpu_node;
+}
+
+/* Returns true if the SIZE bytes at physical address PA can be
+   read yet. */
+static bool
+mapped (uint64_t pa, uint64_t size) {
+	return pa != 0 && pa < BOOT_MAPPED && size <= BOOT_MAPPED - pa;
+}
+
+/* Returns true if the SIZE bytes at P add up to 0 modulo 256, as
+   every ACPI checksum requires. */
+static bool
+checksum_ok (const void *p, size_t size) {
+	const uint8_t *bytes = p;
+	uint8_t sum = 0;
+
+	while (size-- > 0)
+		sum += *bytes++;
+	return sum == 0;
+}
+
+/* Looks for the RSDP in the SIZE bytes at physical address PA. */
+static const struct rsdp *
+scan_rsdp (uint64_t pa, size_t size) {
+	size_t ofs;
+
+	for (ofs = 0; ofs + 20 <= size; ofs += 16) {
+		const struct rsdp *rsdp = ptov (pa + ofs);
+
+		if (!memcmp (rsdp->signature, "RSD PTR ", 8)
+				&& checksum_ok (rsdp, 20))
+			return rsdp;
+	}
+	return NULL;
+}
+
+/* Returns the table at physical address PA if it is readable and
+   has SIGNATURE, otherwise a null pointer. */
+static const struct sdt_header *
+map_table (uint64_t pa, const char *signature) {
+	const struct sdt_header *h;
+
+	if (!mapped (pa, sizeof *h))
+		return NULL;
+	h = ptov (pa);
+	if (memcmp (h->signature, signature, 4) || h->length < sizeof *h
+			|| !mapped (pa, h->length) || !checksum_ok (h, h->length))
+		return NULL;
+	return h;
+}
+
+/* Finds the ACPI table with SIGNATURE.  The RSDP is in the first
+   KB of the Extended BIOS Data Area, whose segment is stored at
+   0x40e, or in the BIOS ROM between 0xe0000 and 0xfffff. */
+static const struct sdt_header *
+find_table (const char *signature) {
+	uint64_t ebda = (uint64_t) *(uint16_t *) ptov (0x40e) << 4;
+	const struct rsdp *rsdp = NULL;
+	const struct sdt_header *root = NULL;
+	size_t entry_size, i;
+
+	if (ebda != 0)
+		rsdp = scan_rsdp (ebda, 1024);
+	if (rsdp == NULL)
+		rsdp = scan_rsdp (0xe0000, 0x20000);
+	if (rsdp == NULL)
+		return NULL;
+
+	if (rsdp->revision >= 2 && rsdp->xsdt != 0) {
+		root = map_table (rsdp->xsdt, "XSDT");
+		entry_size = 8;
+	}
+	if (root == NULL) {
+		root = map_table (rsdp->rsdt, "RSDT");
+		entry_size = 4;
+	}
+	if (root == NULL)
+		return NULL;
+
+	for (i = sizeof *root; i + entry_size <= root->length; i += entry_size) {
+		const uint8_t *entry = (const uint8_t *) root + i;
+		uint64_t pa = entry_size == 8 ? *(const uint64_t *) entry
+			: *(const uint32_t *) entry;
+		const struct sdt_header *h = map_table (pa, signature);
+
+		if (h != NULL)
+			return h;
+	}
+	return NULL;
+}
+
+/* Adds memory [START, END) to the span of DOMAIN. */
+static void
+add_memory (uint32_t domain, uint64_t start, uint64_t end) {
+	struct numa_node *n;
+
+	if (domain >= NUMA_MAX_NODES)
+		domain = 0;
+	for (; numa_node_cnt <= domain; numa_node_cnt++) {
+		numa_nodes[numa_node_cnt].start = UINT64_MAX;
+		numa_nodes[numa_node_cnt].end = 0;
+	}
+
+	n = &numa_nodes[domain];
+	if (n->start > start)
+		n->start = start;
+	if (n->end < end)
+		n->end = end;
+}
+
+/* Records the memory spans and the CPU's node from SRAT.  Leaves a
+   single node if the spans overlap or a node has no memory. */
+static void
+parse_srat (const struct sdt_header *srat) {
+	uint32_t eax, ebx, ecx, edx;
+	uint32_t apic_id;
+	size_t ofs;
+	unsigned i, j;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	apic_id = ebx >> 24;
+
+	for (ofs = SRAT_ENTRIES; ofs + 2 <= srat->length; ) {
+		const uint8_t *entry = (const uint8_t *) srat + ofs;
+
+		if (entry[1] < 2 || ofs + entry[1] > srat->length)
+			break;
+		if (entry[0] == SRAT_MEMORY && entry[1] >= sizeof (struct srat_memory)) {
+			const struct srat_memory *m = (const void *) entry;
+
+			if ((m->flags & SRAT_ENABLED) && !(m->flags & SRAT_HOTPLUG)
+					&& m->size > 0)
+				add_memory (m->domain, m->base, m->base + m->size);
+		} else if (entry[0] == SRAT_CPU && entry[1] >= sizeof (struct srat_cpu)) {
+			const struct srat_cpu *c = (const void *) entry;
+			uint32_t domain = c->domain_lo | c->domain_hi[0] << 8
+				| c->domain_hi[1] << 16 | (uint32_t) c->domain_hi[2] << 24;
+
+			if ((c->flags & SRAT_ENABLED) && c->apic_id == apic_id)
+				cpu_node = domain < NUMA_MAX_NODES ? domain : 0;
+		} else if (entry[0] == SRAT_X2APIC
+				&& entry[1] >= sizeof (struct srat_x2apic)) {
+			const struct srat_x2apic *x = (const void *) entry;
+
+			if ((x->flags & SRAT_ENABLED) && x->x2apic_id == apic_id)
+				cpu_node = x->domain < NUMA_MAX_NODES ? x->domain : 0;
+		}
+		ofs += entry[1];
+	}
+
+	for (i = 0; i < numa_node_cnt; i++) {
+		if (numa_nodes[i].start >= numa_nodes[i].end)
+			goto bad;
+		for (j = 0; j < i; j++)
+			if (numa_nodes[i].start < numa_nodes[j].end
+					&& numa_nodes[j].start < numa_nodes[i].end)
+				goto bad;
+	}
+	if (cpu_node >= numa_node_cnt)
+		cpu_node = 0;
+	return;
+
+bad:
+	printf ("SRAT: nodes overlap or have no memory, ignoring it\n");
+	numa_node_cnt = 0;
+}
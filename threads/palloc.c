@@ -8,7 +8,11 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/memtrack.h"
+#include "threads/numa.h"
+#include "threads/pte.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -24,24 +28,52 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   When the firmware splits memory into NUMA nodes, each node
+   gives half of its pages to each pool, so that every node has
+   user pages for the processes running close to it.  Both pools
+   then span all of memory, and each marks the pages it does not
+   own as used. */
 
 /* A memory pool. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	memtrack_site_t *site_map;      /* Call site of each page, for -mt. */
+	size_t free_cnt;                /* Number of free pages. */
+	size_t page_cnt;                /* Number of pages it owns. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* A NUMA node's part of the user pool. */
+struct node_share {
+	uint64_t split;                 /* Physical address of its first
+	                                   user page. */
+	size_t first, last;             /* Its user pages, [FIRST, LAST),
+	                                   as indexes into user_pool. */
+	size_t free_cnt;                /* Number of them free. */
+	size_t local_cnt;               /* Allocations it satisfied. */
+	size_t remote_cnt;              /* Allocations it had to pass on. */
+};
+static struct node_share nodes[NUMA_MAX_NODES];
+
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static struct pool *pool_of (void *page);
+static void *get_multiple (enum palloc_flags, size_t page_cnt, int node,
+		const void *site);
+static void tag_pages (struct pool *, size_t page_idx, size_t page_cnt,
+		const void *site);
+static void adjust_free_cnt (struct pool *, size_t page_idx,
+		ptrdiff_t delta);
 
 /* multiboot info */
 struct multiboot_info {
@@ -234,6 +266,112 @@ split:
 	}
 }
 
+/* Stores in *START and *END the whole pages of usable ENTRY that
+   lie on NODE, as physical addresses.  Returns false if there are
+   none. */
+static bool
+node_range (const struct e820_entry *entry, const struct numa_node *node,
+		uint64_t *start, uint64_t *end) {
+	uint64_t entry_start = APPEND_HILO (entry->mem_hi, entry->mem_lo);
+	uint64_t entry_end = entry_start + APPEND_HILO (entry->len_hi, entry->len_lo);
+
+	if (entry->type != ACPI_RECLAIMABLE && entry->type != USABLE)
+		return false;
+	*start = ROUND_UP (entry_start > node->start ? entry_start : node->start,
+			PGSIZE);
+	*end = ROUND_DOWN (entry_end < node->end ? entry_end : node->end, PGSIZE);
+	return *start < *end;
+}
+
+/*
+ * Populate the pools when memory is split into NUMA nodes.
+ * Each node gives the pages at its top to the user pool and the
+ * rest to the kernel pool, in the same proportion as
+ * populate_pools() gives memory as a whole.
+ */
+static void
+populate_pools_numa (struct area *base_mem, struct area *ext_mem) {
+	extern char _end;
+	void *free_start = pg_round_up (&_end);
+
+	uint64_t total_pages = (base_mem->size + ext_mem->size) / PGSIZE;
+	uint64_t user_pages = total_pages / 2 > user_page_limit ?
+		user_page_limit : total_pages / 2;
+	uint64_t lo = UINT64_MAX, hi = 0, start, end;
+
+	struct multiboot_info *mb_info = ptov (MULTIBOOT_INFO);
+	struct e820_entry *entries = ptov (mb_info->mmap_base);
+	size_t entry_cnt = mb_info->mmap_len / sizeof (struct e820_entry);
+	struct numa_node all = { 0, UINT64_MAX };
+	unsigned node;
+	size_t i;
+
+	// Find the extent of memory, and where each node's user pages start.
+	for (i = 0; i < entry_cnt; i++)
+		if (node_range (&entries[i], &all, &start, &end)) {
+			if (lo > start)
+				lo = start;
+			if (hi < end)
+				hi = end;
+		}
+
+	for (node = 0; node < numa_node_cnt; node++) {
+		const struct numa_node *n = &numa_nodes[node];
+		uint64_t node_pages = 0, rem;
+
+		for (i = 0; i < entry_cnt; i++)
+			if (node_range (&entries[i], n, &start, &end))
+				node_pages += (end - start) / PGSIZE;
+
+		rem = user_pages * node_pages / total_pages;
+		nodes[node].split = n->end;
+		for (i = entry_cnt; i-- > 0 && rem > 0; )
+			if (node_range (&entries[i], n, &start, &end)) {
+				uint64_t pages = (end - start) / PGSIZE;
+
+				if (pages > rem)
+					pages = rem;
+				rem -= pages;
+				nodes[node].split = end - pages * PGSIZE;
+			}
+	}
+
+	init_pool (&kernel_pool, &free_start, (uint64_t) ptov (lo),
+			(uint64_t) ptov (hi));
+	init_pool (&user_pool, &free_start, (uint64_t) ptov (lo),
+			(uint64_t) ptov (hi));
+	kernel_pool.page_cnt = user_pool.page_cnt = 0;
+
+	for (node = 0; node < numa_node_cnt; node++) {
+		uint64_t first = nodes[node].split < hi ? nodes[node].split : hi;
+		uint64_t last = numa_nodes[node].end < hi ? numa_nodes[node].end : hi;
+
+		if (first < lo)
+			first = lo;
+		if (last < first)
+			last = first;
+		nodes[node].first = (first - lo) / PGSIZE;
+		nodes[node].last = (last - lo) / PGSIZE;
+	}
+
+	// Hand each usable page above the pools' bitmaps to its owner.
+	uint64_t usable_bound = (uint64_t) free_start;
+	for (i = 0; i < entry_cnt; i++)
+		if (node_range (&entries[i], &all, &start, &end)) {
+			uint64_t page = (uint64_t) ptov (start);
+
+			if (page < usable_bound)
+				page = usable_bound;
+			for (; page < (uint64_t) ptov (end); page += PGSIZE) {
+				struct pool *pool = pool_of ((void *) page);
+
+				bitmap_reset (pool->used_map,
+						pg_no (page) - pg_no (pool->base));
+				pool->page_cnt++;
+			}
+		}
+}
+
 /* Initializes the page allocator and get the memory size */
 uint64_t
 palloc_init (void) {
@@ -243,13 +381,35 @@ palloc_init (void) {
 	struct area base_mem = { .size = 0 };
 	struct area ext_mem = { .size = 0 };
 
+	unsigned node;
+
+	numa_init ();
 	resolve_area_info (&base_mem, &ext_mem);
 	printf ("Pintos booting with: \n");
 	printf ("\tbase_mem: 0x%llx ~ 0x%llx (Usable: %'llu kB)\n",
 		  base_mem.start, base_mem.end, base_mem.size / 1024);
 	printf ("\text_mem: 0x%llx ~ 0x%llx (Usable: %'llu kB)\n",
 		  ext_mem.start, ext_mem.end, ext_mem.size / 1024);
-	populate_pools (&base_mem, &ext_mem);
+	if (numa_node_cnt > 1)
+		populate_pools_numa (&base_mem, &ext_mem);
+	else {
+		populate_pools (&base_mem, &ext_mem);
+		nodes[0].first = 0;
+		nodes[0].last = bitmap_size (user_pool.used_map);
+	}
+	kernel_pool.free_cnt = bitmap_count (kernel_pool.used_map, 0,
+			bitmap_size (kernel_pool.used_map), false);
+	user_pool.free_cnt = bitmap_count (user_pool.used_map, 0,
+			bitmap_size (user_pool.used_map), false);
+	for (node = 0; node < numa_node_cnt; node++) {
+		struct node_share *n = &nodes[node];
+
+		n->free_cnt = bitmap_count (user_pool.used_map, n->first,
+				n->last - n->first, false);
+		if (numa_node_cnt > 1)
+			printf ("\tnode %u: 0x%llx ~ 0x%llx (User pages: %zu)\n", node,
+					numa_nodes[node].start, numa_nodes[node].end, n->free_cnt);
+	}
 	return ext_mem.end;
 }
 
@@ -261,10 +421,68 @@ palloc_init (void) {
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
+	return get_multiple (flags, page_cnt, -1, __builtin_return_address (0));
+}
+
+/* Obtains a single free page and returns its kernel virtual
+   address.
+   If PAL_USER is set, the page is obtained from the user pool,
+   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
+   then the page is filled with zeros.  If no pages are
+   available, returns a null pointer, unless PAL_ASSERT is set in
+   FLAGS, in which case the kernel panics. */
+void *
+palloc_get_page (enum palloc_flags flags) {
+	return get_multiple (flags, 1, -1, __builtin_return_address (0));
+}
+
+/* Like palloc_get_page(), but prefers a user page on NUMA node
+   NODE, falling back to the other nodes when it has none free. */
+void *
+palloc_get_page_node (enum palloc_flags flags, unsigned node) {
+	ASSERT (node < numa_node_cnt);
+	return get_multiple (flags, 1, node, __builtin_return_address (0));
+}
+
+/* Charges the PAGE_CNT pages at PAGE_IDX in POOL to call site
+   SITE, if memtrack is enabled. */
+static void
+tag_pages (struct pool *pool, size_t page_idx, size_t page_cnt,
+		const void *site) {
+	size_t i;
+
+	if (pool->site_map != NULL)
+		for (i = 0; i < page_cnt; i++)
+			pool->site_map[page_idx + i] = memtrack_alloc (site, PGSIZE);
+}
+
+/* Does the work of palloc_get_multiple(), charging the pages to
+   call site SITE.  User pages come from NUMA node NODE if it has
+   them, or from any node if NODE is -1. */
+static void *
+get_multiple (enum palloc_flags flags, size_t page_cnt, int node,
+		const void *site) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t page_idx = BITMAP_ERROR;
 
 	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	if (pool == &user_pool && node >= 0 && numa_node_cnt > 1) {
+		struct node_share *n = &nodes[node];
+
+		page_idx = bitmap_scan (pool->used_map, n->first, page_cnt, false);
+		if (page_idx != BITMAP_ERROR && page_idx + page_cnt > n->last)
+			page_idx = BITMAP_ERROR;
+		if (page_idx != BITMAP_ERROR)
+			n->local_cnt++;
+		else
+			n->remote_cnt++;
+	}
+	if (page_idx == BITMAP_ERROR)
+		page_idx = bitmap_scan (pool->used_map, 0, page_cnt, false);
+	if (page_idx != BITMAP_ERROR) {
+		bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+		adjust_free_cnt (pool, page_idx, -(ptrdiff_t) page_cnt);
+	}
 	lock_release (&pool->lock);
 	void *pages;
 
@@ -276,6 +494,7 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	if (pages) {
 		if (flags & PAL_ZERO)
 			memset (pages, 0, PGSIZE * page_cnt);
+		tag_pages (pool, page_idx, page_cnt, site);
 	} else {
 		if (flags & PAL_ASSERT)
 			PANIC ("palloc_get: out of pages");
@@ -284,18 +503,6 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	return pages;
 }
 
-/* Obtains a single free page and returns its kernel virtual
-   address.
-   If PAL_USER is set, the page is obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the page is filled with zeros.  If no pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
-void *
-palloc_get_page (enum palloc_flags flags) {
-	return palloc_get_multiple (flags, 1);
-}
-
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
@@ -306,20 +513,21 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 	if (pages == NULL || page_cnt == 0)
 		return;
 
-	if (page_from_pool (&kernel_pool, pages))
-		pool = &kernel_pool;
-	else if (page_from_pool (&user_pool, pages))
-		pool = &user_pool;
-	else
-		NOT_REACHED ();
-
+	pool = pool_of (pages);
 	page_idx = pg_no (pages) - pg_no (pool->base);
 
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+	if (pool->site_map != NULL) {
+		size_t i;
+
+		for (i = 0; i < page_cnt; i++)
+			memtrack_free (pool->site_map[page_idx + i], PGSIZE);
+	}
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	adjust_free_cnt (pool, page_idx, page_cnt);
 }
 
 /* Frees the page at PAGE. */
@@ -328,6 +536,73 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Adds DELTA to POOL's count of free pages, and to the counts of
+   the NUMA nodes that the pages from PAGE_IDX on belong to.
+   Interrupts are disabled rather than taking the pool's lock,
+   because pages are also freed from the scheduler, which cannot
+   sleep. */
+static void
+adjust_free_cnt (struct pool *pool, size_t page_idx, ptrdiff_t delta) {
+	size_t end_idx = page_idx + (delta < 0 ? -delta : delta);
+	enum intr_level old_level = intr_disable ();
+	unsigned node;
+
+	pool->free_cnt += delta;
+	if (pool == &user_pool)
+		for (node = 0; node < numa_node_cnt; node++) {
+			struct node_share *n = &nodes[node];
+			size_t first = page_idx > n->first ? page_idx : n->first;
+			size_t last = end_idx < n->last ? end_idx : n->last;
+
+			if (first < last)
+				n->free_cnt += delta < 0 ? -(ptrdiff_t) (last - first)
+					: (ptrdiff_t) (last - first);
+		}
+	intr_set_level (old_level);
+}
+
+/* Returns the number of pages in the user pool if FLAGS has
+   PAL_USER set, otherwise in the kernel pool. */
+size_t
+palloc_pool_size (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	return pool->used_map != NULL ? pool->page_cnt : 0;
+}
+
+/* Returns the number of free pages in the user pool if FLAGS has
+   PAL_USER set, otherwise in the kernel pool.  The answer may be
+   stale by the time the caller looks at it. */
+size_t
+palloc_free_cnt (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	return pool->free_cnt;
+}
+
+/* Returns the number of free user pages on NUMA node NODE.  Like
+   palloc_free_cnt(), the answer may be stale. */
+size_t
+palloc_node_free_cnt (unsigned node) {
+	ASSERT (node < numa_node_cnt);
+	return nodes[node].free_cnt;
+}
+
+/* Prints how the user pages of each NUMA node are used, if there
+   is more than one node. */
+void
+palloc_print_stats (void) {
+	unsigned node;
+
+	if (numa_node_cnt <= 1)
+		return;
+	for (node = 0; node < numa_node_cnt; node++) {
+		struct node_share *n = &nodes[node];
+
+		printf ("NUMA node %u: %zu of %zu user pages free, "
+				"%zu local allocations, %zu remote\n", node, n->free_cnt,
+				n->last - n->first, n->local_cnt, n->remote_cnt);
+	}
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
@@ -340,11 +615,37 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
 	lock_init(&p->lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
 	p->base = (void *) start;
+	p->page_cnt = pgcnt;
 
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
 
 	*bm_base += bm_pages;
+
+	// With -mt, keep the call site of each page right after the bitmap.
+	p->site_map = NULL;
+	if (memtrack_enabled) {
+		size_t sm_pages = ROUND_UP (pgcnt * sizeof *p->site_map, PGSIZE);
+		p->site_map = *bm_base;
+		*bm_base += sm_pages;
+	}
+}
+
+/* Returns the pool that owns PAGE. */
+static struct pool *
+pool_of (void *page) {
+	if (numa_node_cnt > 1) {
+		uint64_t pa = vtop (page);
+		unsigned node = numa_node_of (pa);
+
+		return pa >= nodes[node].split && pa < numa_nodes[node].end ?
+			&user_pool : &kernel_pool;
+	}
+	if (page_from_pool (&kernel_pool, page))
+		return &kernel_pool;
+	if (page_from_pool (&user_pool, page))
+		return &user_pool;
+	NOT_REACHED ();
 }
 
 /* Returns true if PAGE was allocated from POOL,
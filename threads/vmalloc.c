@@ -0,0 +1,127 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/init.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Virtually contiguous allocator.
+
+   palloc_get_multiple() needs physically contiguous pages, which
+   become hard to find on a long-running system even when plenty
+   of memory is free.  vmalloc() instead takes single pages from
+   the kernel pool and maps them side by side in a dedicated
+   region of kernel virtual address space.
+
+   The region owns one slot of base_pml4.  Its page-directory-
+   pointer table is created once in vmalloc_init(), before any
+   process exists, so every pml4 copied from base_pml4 shares the
+   lower levels and sees new mappings without further work.
+
+   Each allocation is followed by one unmapped guard page, so an
+   overrun faults instead of silently corrupting the neighbor. */
+
+/* Bitmap of used pages in the region, guard pages included. */
+static struct bitmap *vmalloc_map;
+static uint8_t vmalloc_map_buf[DIV_ROUND_UP (VMALLOC_PAGES, 8) + 64];
+static struct lock vmalloc_lock;
+
+static void unmap_pages (void *pages, size_t page_cnt);
+
+/* Sets up the vmalloc region.  Must be called after paging_init()
+   and before the first user process is created. */
+void
+vmalloc_init (void) {
+	ASSERT (bitmap_buf_size (VMALLOC_PAGES) <= sizeof vmalloc_map_buf);
+
+	vmalloc_map = bitmap_create_in_buf (VMALLOC_PAGES, vmalloc_map_buf,
+			sizeof vmalloc_map_buf);
+	lock_init (&vmalloc_lock);
+
+	/* Populate the upper levels of the page table now, so that
+	   they are shared by every pml4 created afterwards. */
+	if (pml4e_walk (base_pml4, VMALLOC_START, 1) == NULL)
+		PANIC ("vmalloc_init: out of pages");
+}
+
+/* Obtains PAGE_CNT pages that are contiguous in kernel virtual
+   memory, but not necessarily in physical memory.  Returns a
+   null pointer if the region is exhausted, the kernel pool runs
+   out of pages, or vmalloc_init() has not been called yet. */
+void *
+vmalloc (size_t page_cnt) {
+	size_t page_idx, i;
+	uint8_t *pages;
+
+	if (vmalloc_map == NULL || page_cnt == 0)
+		return NULL;
+
+	lock_acquire (&vmalloc_lock);
+	page_idx = bitmap_scan_and_flip (vmalloc_map, 0, page_cnt + 1, false);
+	lock_release (&vmalloc_lock);
+	if (page_idx == BITMAP_ERROR)
+		return NULL;
+
+	pages = (uint8_t *) VMALLOC_START + page_idx * PGSIZE;
+	for (i = 0; i < page_cnt; i++) {
+		uint64_t va = (uint64_t) pages + i * PGSIZE;
+		void *kpage = palloc_get_page (0);
+		uint64_t *pte = kpage != NULL ? pml4e_walk (base_pml4, va, 1) : NULL;
+
+		if (pte == NULL) {
+			palloc_free_page (kpage);
+			unmap_pages (pages, i);
+			lock_acquire (&vmalloc_lock);
+			bitmap_set_multiple (vmalloc_map, page_idx, page_cnt + 1, false);
+			lock_release (&vmalloc_lock);
+			return NULL;
+		}
+		*pte = vtop (kpage) | PTE_P | PTE_W | PTE_G;
+	}
+	return pages;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGES, which must have
+   been obtained from vmalloc() with the same PAGE_CNT. */
+void
+vfree (void *pages, size_t page_cnt) {
+	size_t page_idx;
+
+	if (pages == NULL || page_cnt == 0)
+		return;
+	ASSERT (is_vmalloc_vaddr (pages));
+	ASSERT (pg_ofs (pages) == 0);
+
+	page_idx = pg_no ((uint64_t) pages - VMALLOC_START);
+	unmap_pages (pages, page_cnt);
+
+	lock_acquire (&vmalloc_lock);
+	ASSERT (bitmap_all (vmalloc_map, page_idx, page_cnt + 1));
+	bitmap_set_multiple (vmalloc_map, page_idx, page_cnt + 1, false);
+	lock_release (&vmalloc_lock);
+}
+
+/* Unmaps the PAGE_CNT pages starting at PAGES and returns their
+   frames to the kernel pool. */
+static void
+unmap_pages (void *pages, size_t page_cnt) {
+	size_t i;
+
+	for (i = 0; i < page_cnt; i++) {
+		uint64_t va = (uint64_t) pages + i * PGSIZE;
+		uint64_t *pte = pml4e_walk (base_pml4, va, 0);
+
+		ASSERT (pte != NULL && (*pte & PTE_P));
+		void *kpage = ptov (PTE_ADDR (*pte));
+		*pte = 0;
+		palloc_free_page (kpage);
+	}
+	if (page_cnt > 0)
+		pml4_invalidate_kernel (pages, page_cnt);
+}
@@ -9,8 +9,19 @@
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
+/* User Memory Access */
+/* An entry of the exception table that userprog/uaccess.c builds:
+   a fault on user memory by the instruction at INSN resumes at
+   FIXUP.  The linker script marks the table's bounds. */
+struct ex_entry {
+	uint64_t insn;
+	uint64_t fixup;
+};
+extern const struct ex_entry __start_ex_table[], __stop_ex_table[];
+
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static bool fixup_exception (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -146,6 +157,12 @@ page_fault (struct intr_frame *f) {
 		return;
 #endif
 
+	/* User Memory Access */
+	/* The kernel was reading or writing user memory on behalf of a
+	   system call, which then fails. */
+	if (!user && fixup_exception (f))
+		return;
+
 	/* Count page faults. */
 	page_fault_cnt++;
 
@@ -160,3 +177,17 @@ page_fault (struct intr_frame *f) {
 	exit(-1);
 }
 
+/* User Memory Access */
+/* If the instruction at F's RIP has an entry in the exception
+   table, makes F resume at its fixup code and returns true. */
+static bool
+fixup_exception (struct intr_frame *f) {
+	const struct ex_entry *e;
+
+	for (e = __start_ex_table; e < __stop_ex_table; e++)
+		if (e->insn == f->rip) {
+			f->rip = e->fixup;
+			return true;
+		}
+	return false;
+}
@@ -32,14 +32,6 @@ struct dict_elem{
 	uintptr_t value;
 };
 
-/* Anonymous Page */
-struct load_aux {
-	struct file *file;
-	off_t ofs;
-	uint32_t read_bytes;
-	uint32_t zero_bytes;
-};
-
 static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
@@ -204,6 +196,8 @@ __do_fork (void *aux) {
 
 	process_activate (current);
 #ifdef VM
+	/* Memory Cgroups */
+	current->memcg = parent->memcg;
 	supplemental_page_table_init (&current->spt);
 	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
 		goto error;
@@ -527,6 +521,7 @@ process_activate (struct thread *next) {
 #define PF_X 1          /* Executable. */
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
+#define PF_POPULATE 0x00100000  /* Pintos: load on exec, not on fault. */
 
 /* Executable header.  See [ELF1] 1-4 to 1-8.
  * This appears at the very beginning of an ELF binary. */
@@ -579,6 +574,7 @@ load (const char *file_name, struct intr_frame *if_) {
 	struct file *file = NULL;
 	off_t file_ofs;
 	bool success = false;
+	bool populate = false;
 	int i;
 
 	/* Allocate and activate page directory. */
@@ -598,6 +594,11 @@ load (const char *file_name, struct intr_frame *if_) {
 	t->running = file;
 	file_deny_write (file);
 
+#ifdef VM
+	/* Populate */
+	populate = vm_populate_exec (file_name);
+#endif
+
 	/* Read and verify executable header. */
 	if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
 			|| memcmp (ehdr.e_ident, "\177ELF\2\1\1", 7)
@@ -656,6 +657,12 @@ load (const char *file_name, struct intr_frame *if_) {
 					if (!load_segment (file, file_page, (void *) mem_page,
 								read_bytes, zero_bytes, writable))
 						goto done;
+#ifdef VM
+					/* Populate */
+					if ((phdr.p_flags & PF_POPULATE) || populate)
+						vm_populate ((void *) mem_page,
+								(void *) mem_page + read_bytes + zero_bytes);
+#endif
 				}
 				else
 					goto done;
@@ -733,6 +740,11 @@ validate_segment (const struct Phdr *phdr, struct file *file) {
 
 /* load() helpers. */
 static bool install_page (void *upage, void *kpage, bool writable);
+static bool install_pages (void *upage, void **kpages, size_t page_cnt,
+		bool writable);
+
+/* Number of pages load_segment() maps with one pml4_map_range(). */
+#define LOAD_BATCH 32
 
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
@@ -751,6 +763,10 @@ static bool install_page (void *upage, void *kpage, bool writable);
 static bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		uint32_t read_bytes, uint32_t zero_bytes, bool writable) {
+	void *kpages[LOAD_BATCH];
+	size_t batch_cnt = 0;
+	uint8_t *batch_upage = upage;
+
 	ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
@@ -766,28 +782,34 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		/* Get a page of memory. */
 		uint8_t *kpage = palloc_get_page (PAL_USER);
 		if (kpage == NULL)
-			return false;
+			goto fail;
+		kpages[batch_cnt++] = kpage;
 
 		/* Load this page. */
-		if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes) {
-			palloc_free_page (kpage);
-			return false;
-		}
+		if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
+			goto fail;
 		memset (kpage + page_read_bytes, 0, page_zero_bytes);
 
-		/* Add the page to the process's address space. */
-		if (!install_page (upage, kpage, writable)) {
-			printf("fail\n");
-			palloc_free_page (kpage);
-			return false;
-		}
-
 		/* Advance. */
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
 		upage += PGSIZE;
+
+		/* Add a full batch, or the final pages, to the process's
+		 * address space in one page-table walk. */
+		if (batch_cnt == LOAD_BATCH || (read_bytes == 0 && zero_bytes == 0)) {
+			if (!install_pages (batch_upage, kpages, batch_cnt, writable))
+				goto fail;
+			batch_cnt = 0;
+			batch_upage = upage;
+		}
 	}
 	return true;
+
+fail:
+	while (batch_cnt > 0)
+		palloc_free_page (kpages[--batch_cnt]);
+	return false;
 }
 
 /* Create a minimal stack by mapping a zeroed page at the USER_STACK */
@@ -825,32 +847,21 @@ install_page (void *upage, void *kpage, bool writable) {
 	return (pml4_get_page (t->pml4, upage) == NULL
 			&& pml4_set_page (t->pml4, upage, kpage, writable));
 }
-#else
-/* From here, codes will be used after project 3.
- * If you want to implement the function for only project 2, implement it on the
- * upper block. */
 
+/* Like install_page(), but maps the PAGE_CNT pages starting at
+ * UPAGE to KPAGES[0] through KPAGES[PAGE_CNT - 1] at once.
+ * Returns false, mapping nothing, if any of them is already
+ * mapped or if memory allocation fails. */
 static bool
-lazy_load_segment (struct page *page, void *aux) {
-	/* Anonymous Page */
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
-	
-	struct load_aux *load_aux = (struct load_aux *)aux;
-
-	file_seek (load_aux->file, load_aux->ofs);
-
-	if (file_read (load_aux->file, page->frame->kva, load_aux->read_bytes) != (int)(load_aux->read_bytes)) {
-		palloc_free_page (page->frame->kva);
-
-		return false;
-	}
-
-	memset (page->frame->kva + load_aux->read_bytes, 0, load_aux->zero_bytes);
+install_pages (void *upage, void **kpages, size_t page_cnt, bool writable) {
+	struct thread *t = thread_current ();
 
-	return true;
+	return pml4_map_range (t->pml4, upage, kpages, page_cnt, writable);
 }
+#else
+/* From here, codes will be used after project 3.
+ * If you want to implement the function for only project 2, implement it on the
+ * upper block. */
 
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
@@ -873,34 +884,18 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
-	while (read_bytes > 0 || zero_bytes > 0) {
-		/* Do calculate how to fill this page.
-		 * We will read PAGE_READ_BYTES bytes from FILE
-		 * and zero the final PAGE_ZERO_BYTES bytes. */
-		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-		size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-		/* Anonymous Page */
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		struct load_aux *load_aux = (struct load_aux *)malloc (sizeof (struct load_aux));
-		load_aux->file = file;
-		load_aux->ofs = ofs;
-		load_aux->read_bytes = page_read_bytes;
-		load_aux->zero_bytes = page_zero_bytes;
-
-		/* Anonymous Page */
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, load_aux))
-			return false;
+	/* VMA */
+	/* One area covers the whole segment.  Its pages are created and
+	 * read in when first touched. */
+	struct vma *vma = vma_create (&thread_current ()->spt.vmas, upage,
+			(read_bytes + zero_bytes) / PGSIZE, VM_ANON, writable, file, ofs,
+			read_bytes);
+	if (vma == NULL)
+		return false;
 
-		/* Advance. */
-		read_bytes -= page_read_bytes;
-		zero_bytes -= page_zero_bytes;
-		upage += PGSIZE;
-		
-		/* Anonymous Page */
-		ofs += page_read_bytes;
-	}
+	/* Shared Text */
+	if (!writable)
+		vm_share_text (vma);
 	return true;
 }
 
@@ -915,7 +910,10 @@ setup_stack (struct intr_frame *if_) {
 	 * TODO: If success, set the rsp accordingly.
 	 * TODO: You should mark the page is stack. */
 	/* TODO: Your code goes here */
-	if (vm_alloc_page (VM_ANON | VM_MARKER_0, stack_bottom, true)) {
+	/* Stack Growth */
+	/* The stack is an area, grown down by page faults. */
+	if (vma_create (&thread_current ()->spt.vmas, stack_bottom, 1,
+				VM_ANON | VM_MARKER_0, true, NULL, 0, 0) != NULL) {
 		success = vm_claim_page (stack_bottom);
 
 		if (success) {
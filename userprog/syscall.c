@@ -19,6 +19,16 @@
 #include "threads/palloc.h"
 #include "filesys/file.h"
 
+/* User Memory Access */
+#include <string.h>
+#include "threads/malloc.h"
+#include "userprog/uaccess.h"
+#ifdef VM
+#include "vm/userfault.h"
+#include "vm/memcg.h"
+#include <round.h>
+#endif
+
 /* Denying Write To Executable */
 const int STDIN = 1;
 const int STDOUT = 2;
@@ -26,8 +36,7 @@ const int STDOUT = 2;
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
 
-/* User Memory Access */
-void check_address (void *addr);
+static char *get_user_string (const char *ustr);
 
 /* System Call */
 void halt (void);
@@ -59,6 +68,27 @@ tid_t fork (const char *thread_name, struct intr_frame *f);
 /* Dup2 */
 int dup2 (int oldfd, int newfd);
 
+/* Memory Mapped Files */
+#ifdef VM
+void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
+void munmap (void *addr);
+int msync (void *addr, size_t length);
+int madvise (void *addr, size_t length, int advice);
+
+/* VM Statistics */
+int vmstat (int which, struct vmstat *stats);
+
+/* Userfault */
+int userfaultfd (void);
+int uffd_register (int fd, void *addr, size_t length);
+int uffd_copy (int fd, void *dst, const void *src, size_t length);
+
+/* Memory Cgroups */
+int memcg_new (size_t limit);
+int memcg_join (int id);
+int memcg_stat (int id, struct memcg_stat *stat);
+#endif
+
 /* System call.
  *
  * Previously system call services was handled by the interrupt handler
@@ -147,29 +177,71 @@ syscall_handler (struct intr_frame *f UNUSED) {
 		case SYS_DUP2:
 			f->R.rax = dup2 (f->R.rdi, f->R.rsi);
 			break;
+#ifdef VM
+		/* Memory Mapped Files */
+		case SYS_MMAP:
+			f->R.rax = (uint64_t) mmap ((void *) f->R.rdi, f->R.rsi, f->R.rdx,
+					f->R.r10, f->R.r8);
+			break;
+		case SYS_MUNMAP:
+			munmap ((void *) f->R.rdi);
+			break;
+		case SYS_MSYNC:
+			f->R.rax = msync ((void *) f->R.rdi, f->R.rsi);
+			break;
+		case SYS_MADVISE:
+			f->R.rax = madvise ((void *) f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_VMSTAT:
+			f->R.rax = vmstat (f->R.rdi, (struct vmstat *) f->R.rsi);
+			break;
+		case SYS_USERFAULTFD:
+			f->R.rax = userfaultfd ();
+			break;
+		case SYS_UFFD_REGISTER:
+			f->R.rax = uffd_register (f->R.rdi, (void *) f->R.rsi, f->R.rdx);
+			break;
+		case SYS_UFFD_COPY:
+			f->R.rax = uffd_copy (f->R.rdi, (void *) f->R.rsi,
+					(const void *) f->R.rdx, f->R.r10);
+			break;
+		case SYS_MEMCG_NEW:
+			f->R.rax = memcg_new (f->R.rdi);
+			break;
+		case SYS_MEMCG_JOIN:
+			f->R.rax = memcg_join (f->R.rdi);
+			break;
+		case SYS_MEMCG_STAT:
+			f->R.rax = memcg_stat (f->R.rdi, (struct memcg_stat *) f->R.rsi);
+			break;
+#endif
 		default:
 			exit (-1);
 			break;
 	}
 }
 
-/* Stack Growth */
 /* User Memory Access */
-/* Check if the address value is within the range of addresses used by the user space. */
-/* If the address is outside the user space, terminate the process. */
-void
-check_address (void *addr) {
- 	struct thread *curr = thread_current();
-
-#ifdef VM
- 	if (addr == NULL || is_kernel_vaddr (addr) || spt_find_page (&curr->spt, addr) == NULL)
-        exit (-1);
-#else
-	if (!is_user_vaddr (addr) || pml4_get_page (curr->pml4, addr) == NULL) {
+/* Copies the string at user address USTR into a new page, which
+ * the caller must free, truncating it to a page.  Terminates the
+ * process if the string is not readable. */
+static char *
+get_user_string (const char *ustr) {
+	char *kstr = palloc_get_page (0);
+	long len;
+
+	if (kstr == NULL) {
 		exit (-1);
 	}
-#endif
-
+	len = strncpy_from_user (kstr, ustr, PGSIZE);
+	if (len == -1) {
+		palloc_free_page (kstr);
+		exit (-1);
+	}
+	if (len == PGSIZE) {
+		kstr[PGSIZE - 1] = '\0';
+	}
+	return kstr;
 }
 
 /* System Call */
@@ -196,17 +268,29 @@ exit (int status) {
 /* A system call to duplicate a new process from the currently executing process. */
 tid_t
 fork (const char *thread_name, struct intr_frame *f) {
-	return process_fork (thread_name, f);
+	/* User Memory Access */
+	char name[16];
+	long len = strncpy_from_user (name, thread_name, sizeof name);
+
+	if (len == -1) {
+		exit (-1);
+	}
+	if (len == sizeof name) {
+		name[sizeof name - 1] = '\0';
+	}
+	return process_fork (name, f);
 }
 
 /* System Call */
 /* "A system call that takes a file name and size as arguments to create a file. */
 bool
 create (const char *file, unsigned initial_size) {
-	check_address (file);
+	char *name = get_user_string (file);
+
 	lock_acquire (&filesys_lock);
-	bool success = filesys_create (file, initial_size);
+	bool success = filesys_create (name, initial_size);
 	lock_release (&filesys_lock);
+	palloc_free_page (name);
 	return success;
 }
 
@@ -214,24 +298,18 @@ create (const char *file, unsigned initial_size) {
 /* A function to remove a file corresponding to the file name. */
 bool
 remove (const char *file) {
-	check_address (file);
-	return filesys_remove (file);
+	char *name = get_user_string (file);
+	bool success = filesys_remove (name);
+
+	palloc_free_page (name);
+	return success;
 }
 
 /* Hierarchical Process Structure */
 /* A system call to create a child process and execute a program. */
 int
 exec (const char *file_name) {
-	check_address (file_name);
-
-	int size = strlen (file_name) + 1;
-	char *fn_copy = palloc_get_page (PAL_ZERO);
-
-	if (fn_copy == NULL) {
-		exit (-1);
-	}
-
-	strlcpy (fn_copy, file_name, size);
+	char *fn_copy = get_user_string (file_name);
 
 	if (process_exec (fn_copy) == -1) {
 		return -1;
@@ -253,20 +331,20 @@ wait (tid_t pid) {
 /* A system call used to open a file. */
 int
 open (const char *file) {
-	check_address (file);
+	char *name = get_user_string (file);
 
 	lock_acquire (&filesys_lock);
 
-	struct file *file_obj = filesys_open (file);
-
-	if (file_obj == NULL) {
-		return -1;
-	}
+	struct file *file_obj = filesys_open (name);
+	int fd = -1;
 
-	int fd = process_add_file (file_obj);
+	palloc_free_page (name);
+	if (file_obj != NULL) {
+		fd = process_add_file (file_obj);
 
-	if (fd == -1) {
-		file_close (file_obj);
+		if (fd == -1) {
+			file_close (file_obj);
+		}
 	}
 	
 	lock_release (&filesys_lock);
@@ -280,7 +358,7 @@ int
 filesize (int fd) {
 	struct file *file_obj = process_get_file (fd);
 
-	if (file_obj == NULL) {
+	if (file_obj == NULL || file_obj->uffd != NULL) {
 		return -1;
 	}
 
@@ -291,19 +369,17 @@ filesize (int fd) {
 /* A system call for reading data from an open file. */
 int
 read (int fd, void *buffer, unsigned size) {
-	check_address(buffer);
-
-	/* Stack Growth */
-	/* pt-write-code2 */
-	struct page *p = spt_find_page (&thread_current ()->spt, pg_round_down(buffer));
-	if (p == NULL || p->writable == false) {
+	/* User Memory Access */
+	/* The data goes straight into BUFFER.  Its pages are faulted in
+	 * first, so that a bad pointer ends the process here rather than
+	 * in the middle of a read that holds filesys_lock. */
+	if (!fault_in_writable (buffer, size)) {
 		exit (-1);
 	}
 
-	unsigned char *read_buffer = (char *)buffer;
 	struct thread *curr = thread_current ();
 	struct file *file_obj = process_get_file (fd);
-	int read_count;
+	int read_count = 0;
 
 	if (file_obj == NULL) {
 		return -1;
@@ -313,27 +389,36 @@ read (int fd, void *buffer, unsigned size) {
 		return -1;
 	}	
 
+	/* Dup2 */
+	if (file_obj == STDIN && curr->stdin_count == 0) {
+		NOT_REACHED ();
+		process_close_file (fd);
+		return -1;
+	}
+
 	if (file_obj == STDIN) {
-		/* Dup2 */
-		if (curr->stdin_count == 0) {
-			NOT_REACHED ();
-			process_close_file (fd);
-			read_count = -1;
-		}
-		else {
-			char key;
-			for (read_count = 0; read_count < size; read_count++) {
-				key = input_getc ();
-				*read_buffer++ = key;
-				if (key == '\0') {
-					break;
-				}
+		char key;
+		for (read_count = 0; (unsigned) read_count < size; read_count++) {
+			key = input_getc ();
+			((char *) buffer)[read_count] = key;
+			if (key == '\0') {
+				break;
 			}
 		}
 	}
+#ifdef VM
+	else if (file_obj->uffd != NULL) {
+		/* Userfault */
+		read_count = userfault_read (file_obj->uffd, buffer, size);
+	}
+#endif
 	else {
 		lock_acquire (&filesys_lock);
+#ifdef VM
+		read_count = vm_file_read (file_obj, buffer, size);
+#else
 		read_count = file_read (file_obj, buffer, size);
+#endif
 		lock_release (&filesys_lock);
 	}
 
@@ -344,11 +429,16 @@ read (int fd, void *buffer, unsigned size) {
 /* A system call for writing data to an open file. */
 int
 write (int fd, const void *buffer, unsigned size) {
-	check_address (buffer);
+	/* User Memory Access */
+	/* As in read(), the data is taken straight from BUFFER once its
+	 * pages are known to be readable. */
+	if (!fault_in_readable (buffer, size)) {
+		exit (-1);
+	}
 
 	struct thread *curr = thread_current ();
 	struct file *file_obj = process_get_file (fd);
-	int write_count;
+	int write_count = 0;
 
 	if (file_obj == NULL || file_obj == STDIN) {
 		return -1;
@@ -359,18 +449,25 @@ write (int fd, const void *buffer, unsigned size) {
 		if (curr->stdout_count == 0) {
 			NOT_REACHED ();
 			process_close_file (fd);
-			write_count = -1;
-		}
-		else {
-			putbuf (buffer, size);
-			write_count = size;
+			return -1;
 		}
+		putbuf (buffer, size);
+		write_count = size;
+	}
+	else if (file_obj->uffd != NULL) {
+		/* Userfault */
+		return -1;
 	}
 	else {
 		lock_acquire (&filesys_lock);
+#ifdef VM
+		write_count = vm_file_write (file_obj, buffer, size);
+#else
 		write_count = file_write (file_obj, buffer, size);
+#endif
 		lock_release (&filesys_lock);
 	}
+
 	return write_count;
 }
 
@@ -516,4 +613,199 @@ dup2 (int oldfd, int newfd) {
 	curr_fdt[newfd] = file_obj;
 
 	return newfd;
-}
\ No newline at end of file
+}
+#ifdef VM
+/* Memory Mapped Files */
+/* A system call that maps LENGTH bytes of the file open as FD,
+ * starting at OFFSET, into memory at ADDR.  With MAP_POPULATE or'ed
+ * into WRITABLE, the pages are read in now rather than on first
+ * touch. */
+void *
+mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
+	struct file *file_obj = process_get_file (fd);
+	bool populate = (writable & MAP_POPULATE) != 0;
+
+	if (file_obj == NULL || file_obj == STDIN || file_obj == STDOUT
+			|| file_obj->uffd != NULL) {
+		return NULL;
+	}
+
+	if (addr == NULL || pg_ofs (addr) != 0 || is_kernel_vaddr (addr)
+			|| length == 0 || pg_ofs (offset) != 0) {
+		return NULL;
+	}
+
+	/* Populate */
+	writable &= ~MAP_POPULATE;
+	if (do_mmap (addr, length, writable, file_obj, offset) == NULL) {
+		return NULL;
+	}
+	if (populate) {
+		vm_populate (addr, addr + ROUND_UP (length, PGSIZE));
+	}
+	return addr;
+}
+
+/* Memory Mapped Files */
+/* A system call that removes the mapping made at ADDR. */
+void
+munmap (void *addr) {
+	do_munmap (addr);
+}
+
+/* Memory Mapped Files */
+/* A system call that writes back the mapped pages in the LENGTH
+ * bytes at ADDR. */
+int
+msync (void *addr, size_t length) {
+	return do_msync (addr, length);
+}
+
+/* Memory Mapped Files */
+/* A system call that tells the VM how the LENGTH bytes at ADDR
+ * will be used. */
+int
+madvise (void *addr, size_t length, int advice) {
+	return vm_madvise (addr, length, advice);
+}
+
+/* VM Statistics */
+/* A system call that copies into STATS the event counts of the
+ * calling process, if WHICH is VMSTAT_SELF, or of the whole system,
+ * if it is VMSTAT_GLOBAL, along with the fault latency histograms. */
+int
+vmstat (int which, struct vmstat *stats) {
+	struct vmstat *kstats;
+	size_t left;
+
+	if (which != VMSTAT_SELF && which != VMSTAT_GLOBAL) {
+		return -1;
+	}
+	kstats = malloc (sizeof *kstats);
+	if (kstats == NULL) {
+		return -1;
+	}
+	vm_get_stats (kstats, which == VMSTAT_GLOBAL);
+	left = copy_to_user (stats, kstats, sizeof *kstats);
+	free (kstats);
+	if (left != 0) {
+		exit (-1);
+	}
+	return 0;
+}
+
+/* Userfault */
+/* Returns the userfault object open as FD, or NULL. */
+static struct userfault *
+get_userfault (int fd) {
+	struct file *file_obj = process_get_file (fd);
+
+	if (file_obj == NULL || file_obj == STDIN || file_obj == STDOUT) {
+		return NULL;
+	}
+	return file_obj->uffd;
+}
+
+/* Userfault */
+/* A system call that creates a userfault object and returns a
+ * file descriptor for it.  read() on the descriptor waits for a
+ * fault on an area registered with it and returns a struct
+ * uffd_msg. */
+int
+userfaultfd (void) {
+	struct userfault *uffd = userfault_create ();
+	struct file *file_obj;
+	int fd;
+
+	if (uffd == NULL) {
+		return -1;
+	}
+	file_obj = file_open_userfault (uffd);
+	if (file_obj == NULL) {
+		userfault_close (uffd);
+		return -1;
+	}
+
+	fd = process_add_file (file_obj);
+	if (fd == -1) {
+		file_close (file_obj);
+	}
+	return fd;
+}
+
+/* Userfault */
+/* A system call that maps LENGTH bytes of anonymous memory at ADDR,
+ * whose faults are forwarded to the userfault object open as FD
+ * instead of being filled with zeros. */
+int
+uffd_register (int fd, void *addr, size_t length) {
+	struct userfault *uffd = get_userfault (fd);
+
+	if (uffd == NULL || addr == NULL || pg_ofs (addr) != 0
+			|| is_kernel_vaddr (addr) || length == 0) {
+		return -1;
+	}
+	return userfault_register (uffd, &thread_current ()->spt, addr, length)
+		? 0 : -1;
+}
+
+/* Userfault */
+/* A system call that fills the pages at DST, waiting on the
+ * userfault object open as FD, with the LENGTH bytes at SRC, and
+ * returns the number of bytes copied. */
+int
+uffd_copy (int fd, void *dst, const void *src, size_t length) {
+	struct userfault *uffd = get_userfault (fd);
+
+	if (uffd == NULL || length == 0) {
+		return -1;
+	}
+	if (!access_ok (src, length)) {
+		exit (-1);
+	}
+	return userfault_copy (uffd, dst, src, length);
+}
+
+/* Memory Cgroups */
+/* A system call that creates a memory cgroup whose processes may
+ * hold LIMIT frames together, or any number if LIMIT is 0, and
+ * returns its id. */
+int
+memcg_new (size_t limit) {
+	struct memcg *memcg = memcg_alloc (limit);
+
+	return memcg != NULL ? memcg->id : -1;
+}
+
+/* Memory Cgroups */
+/* A system call that moves the calling process into the memory
+ * cgroup ID, along with the children it forks from now on. */
+int
+memcg_join (int id) {
+	struct memcg *memcg = memcg_lookup (id);
+
+	if (memcg == NULL) {
+		return -1;
+	}
+	thread_current ()->memcg = memcg;
+	return 0;
+}
+
+/* Memory Cgroups */
+/* A system call that copies the limit, charges and counters of
+ * the memory cgroup ID into STAT. */
+int
+memcg_stat (int id, struct memcg_stat *stat) {
+	struct memcg *memcg = memcg_lookup (id);
+	struct memcg_stat kstat;
+
+	if (memcg == NULL) {
+		return -1;
+	}
+	memcg_get_stat (memcg, &kstat);
+	if (copy_to_user (stat, &kstat, sizeof kstat) != 0) {
+		exit (-1);
+	}
+	return 0;
+}
+#endif
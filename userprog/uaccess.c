@@ -0,0 +1,134 @@
+#include "userprog/uaccess.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* Kernel access to user memory.
+
+   System calls do not look user pointers up in the page tables
+   before using them.  These routines access user memory
+   directly.  A fault on a page that is valid but not loaded yet is
+   resolved as usual, and the access is retried.  Every
+   instruction here that touches user memory has an entry in the
+   exception table, section __ex_table, so if the fault cannot be
+   resolved, page_fault() resumes at the entry's fixup code, which
+   reports the failure, instead of killing the process.  The only
+   check made up front is that the memory lies below KERN_BASE, so
+   that a user pointer cannot reach into the kernel.
+
+   The checks thus cost nothing when the pointers are good, which
+   is nearly always. */
+
+/* Records that a fault at label FROM resumes at label TO. */
+#define EX_TABLE(FROM, TO)                      \
+	".section __ex_table, \"a\"\n"              \
+	".balign 8\n"                               \
+	".quad " #FROM ", " #TO "\n"                \
+	".previous\n"
+
+/* Returns true if the SIZE bytes at UADDR lie in user space.  They
+   need not be mapped. */
+bool
+access_ok (const void *uaddr, size_t size) {
+	uintptr_t start = (uintptr_t) uaddr;
+
+	return size == 0
+		|| (start + size > start && is_user_vaddr (start + size - 1));
+}
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns the
+   number of bytes that could not be copied, 0 on success. */
+size_t
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	if (!access_ok (usrc, size))
+		return size;
+
+	/* On a fault, RCX holds the bytes left. */
+	asm volatile ("1: rep movsb\n"
+			"2:\n"
+			EX_TABLE (1b, 2b)
+			: "+D" (dst), "+S" (usrc), "+c" (size) : : "memory");
+	return size;
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns the
+   number of bytes that could not be copied, 0 on success. */
+size_t
+copy_to_user (void *udst, const void *src, size_t size) {
+	if (!access_ok (udst, size))
+		return size;
+
+	asm volatile ("1: rep movsb\n"
+			"2:\n"
+			EX_TABLE (1b, 2b)
+			: "+D" (udst), "+S" (src), "+c" (size) : : "memory");
+	return size;
+}
+
+/* Touches every page of the SIZE bytes at user address UADDR, so
+   that they are loaded and readable.  A caller about to take a
+   lock that a fault must not happen under can then read them
+   directly.  Returns false if some page cannot be read. */
+bool
+fault_in_readable (const void *uaddr, size_t size) {
+	const uint8_t *p = uaddr;
+	const uint8_t *end = p + size;
+	uint8_t byte;
+
+	if (!access_ok (uaddr, size))
+		return false;
+	for (; p < end; p = pg_round_down (p) + PGSIZE)
+		if (copy_from_user (&byte, p, 1) != 0)
+			return false;
+	return true;
+}
+
+/* Like fault_in_readable(), but also writes each page back
+   unchanged, so that it is writable and any copy on write has
+   been made.  Returns false if some page cannot be written. */
+bool
+fault_in_writable (void *uaddr, size_t size) {
+	uint8_t *p = uaddr;
+	uint8_t *end = p + size;
+	uint8_t byte;
+
+	if (!access_ok (uaddr, size))
+		return false;
+	for (; p < end; p = pg_round_down (p) + PGSIZE)
+		if (copy_from_user (&byte, p, 1) != 0
+				|| copy_to_user (p, &byte, 1) != 0)
+			return false;
+	return true;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, which has room for SIZE bytes.  Returns the length of the
+   string, or SIZE if it does not end within SIZE bytes, in which
+   case DST is not null-terminated.  Returns -1 if the string runs
+   into memory the process may not read. */
+long
+strncpy_from_user (char *dst, const char *usrc, size_t size) {
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		int ok = 1;
+		char c;
+
+		if (!is_user_vaddr (usrc + i))
+			return -1;
+		asm volatile ("1: movb (%2), %1\n"
+				"2:\n"
+				".section .fixup, \"ax\"\n"
+				"3: movl $0, %0\n"
+				"   jmp 2b\n"
+				".previous\n"
+				EX_TABLE (1b, 3b)
+				: "+r" (ok), "=q" (c) : "r" (usrc + i));
+		if (!ok)
+			return -1;
+		dst[i] = c;
+		if (c == '\0')
+			return i;
+	}
+	return size;
+}
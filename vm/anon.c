@@ -3,6 +3,18 @@
 #include "vm/vm.h"
 #include "devices/disk.h"
 
+/* Swap */
+#include <bitmap.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Compressed Swap */
+#include "vm/zswap.h"
+
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
 static bool anon_swap_in (struct page *page, void *kva);
@@ -17,11 +29,288 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Swap */
+/* The swap disk is divided into page-sized slots of
+ * SECTORS_PER_SLOT sectors each, tracked by SWAP_MAP.  Slots are
+ * handed out next-fit from SWAP_CURSOR, so pages evicted together
+ * land next to each other on disk.
+ *
+ * Swapping in reads up to SWAP_RA_WINDOW - 1 of the following
+ * slots as well, into a small cache of pages, on the bet that they
+ * were evicted together and will be wanted together.
+ *
+ * While a batch is open, from anon_swap_batch_begin() to
+ * anon_swap_batch_end(), pages swapped out to adjacent slots are
+ * gathered and written with one disk command per run. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+#define SWAP_RA_WINDOW 4        /* Slots read per swap-in. */
+#define SWAP_RA_CACHE 8         /* Pages in the readahead cache. */
+#define SWAP_BATCH_MAX 8        /* Pages written per command. */
+
+static struct bitmap *swap_map;
+static uint16_t *slot_refs;     /* Number of pages sharing each slot. */
+static size_t swap_cursor;
+static struct lock swap_lock;
+
+/* A slot read ahead of use. */
+struct ra_entry {
+	size_t slot;                /* Slot cached, or BITMAP_ERROR. */
+	void *kva;                  /* Copy of the slot's contents. */
+};
+static struct ra_entry ra_cache[SWAP_RA_CACHE];
+static size_t ra_next;          /* Entry to replace next. */
+
+/* Pages swapped out in the open batch but not written yet. */
+static int batch_depth;         /* Nesting of open batches. */
+static uint8_t *batch_buf;      /* Room for SWAP_BATCH_MAX pages. */
+static size_t batch_start;      /* Slot of the first page held. */
+static size_t batch_cnt;        /* Pages held. */
+
+static long long swap_out_cnt;  /* # of pages written to swap. */
+static long long swap_in_cnt;   /* # of pages read from swap. */
+static long long ra_hit_cnt;    /* # of swap-ins served by readahead. */
+
+static void write_slot (size_t slot, const void *kva);
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
 	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	/* Swap */
+	lock_init (&swap_lock);
+	swap_disk = disk_get (1, 1);
+	if (swap_disk == NULL) {
+		return;
+	}
+
+	size_t slot_cnt = disk_size (swap_disk) / SECTORS_PER_SLOT;
+	swap_map = bitmap_create (slot_cnt);
+	slot_refs = calloc (slot_cnt, sizeof *slot_refs);
+	if (swap_map == NULL || slot_refs == NULL) {
+		PANIC ("vm_anon_init: out of memory");
+	}
+
+	/* The cache's pages are contiguous, so that slots read ahead
+	 * together go into them with one command. */
+	uint8_t *ra_pages = palloc_get_multiple (0, SWAP_RA_CACHE);
+	batch_buf = palloc_get_multiple (0, SWAP_BATCH_MAX);
+	if (ra_pages == NULL || batch_buf == NULL) {
+		PANIC ("vm_anon_init: out of memory");
+	}
+	for (size_t i = 0; i < SWAP_RA_CACHE; i++) {
+		ra_cache[i].slot = BITMAP_ERROR;
+		ra_cache[i].kva = ra_pages + i * PGSIZE;
+	}
+
+	/* Compressed Swap */
+	zswap_init (slot_cnt, write_slot);
+}
+
+/* Swap */
+/* Prints swap statistics. */
+void
+vm_anon_print_stats (void) {
+	if (swap_map != NULL) {
+		printf ("Swap: %lld pages out, %lld pages in (%lld from readahead), "
+				"%zu of %zu slots in use\n", swap_out_cnt, swap_in_cnt,
+				ra_hit_cnt, bitmap_count (swap_map, 0, bitmap_size (swap_map), true),
+				bitmap_size (swap_map));
+	}
+
+	/* Compressed Swap */
+	zswap_print_stats ();
+}
+
+/* Swap */
+/* Returns the readahead cache entry for SLOT, or NULL if it is not
+ * cached.  The caller must hold swap_lock. */
+static struct ra_entry *
+ra_lookup (size_t slot) {
+	for (size_t i = 0; i < SWAP_RA_CACHE; i++) {
+		if (ra_cache[i].slot == slot) {
+			return &ra_cache[i];
+		}
+	}
+	return NULL;
+}
+
+/* Swap */
+/* Reads SLOT from the swap disk into KVA. */
+static void
+read_slot (size_t slot, void *kva) {
+	disk_read_multiple (swap_disk, slot * SECTORS_PER_SLOT, kva,
+			SECTORS_PER_SLOT);
+}
+
+/* Swap */
+/* Writes KVA to SLOT on the swap disk. */
+static void
+write_slot (size_t slot, const void *kva) {
+	disk_write_multiple (swap_disk, slot * SECTORS_PER_SLOT, kva,
+			SECTORS_PER_SLOT);
+}
+
+/* Swap */
+/* Returns the copy of SLOT held in the open batch, or NULL if it is
+ * not there.  The caller must hold swap_lock. */
+static void *
+batch_lookup (size_t slot) {
+	if (batch_cnt > 0 && slot >= batch_start && slot < batch_start + batch_cnt) {
+		return batch_buf + (slot - batch_start) * PGSIZE;
+	}
+	return NULL;
+}
+
+/* Swap */
+/* Writes the pages held in the batch to disk.  The caller must
+ * hold swap_lock. */
+static void
+batch_flush (void) {
+	if (batch_cnt > 0) {
+		disk_write_multiple (swap_disk, batch_start * SECTORS_PER_SLOT,
+				batch_buf, batch_cnt * SECTORS_PER_SLOT);
+		batch_cnt = 0;
+	}
+}
+
+/* Swap */
+/* Adds a copy of KVA, just given SLOT, to the open batch, writing
+ * out what the batch held first if SLOT does not extend it.
+ * Returns false, doing nothing, if no batch is open.  The caller
+ * must hold swap_lock. */
+static bool
+batch_add (size_t slot, const void *kva) {
+	if (batch_depth == 0) {
+		return false;
+	}
+	if (batch_cnt > 0
+			&& (slot != batch_start + batch_cnt || batch_cnt == SWAP_BATCH_MAX)) {
+		batch_flush ();
+	}
+	if (batch_cnt == 0) {
+		batch_start = slot;
+	}
+	memcpy (batch_buf + batch_cnt++ * PGSIZE, kva, PGSIZE);
+	return true;
+}
+
+/* Swap */
+/* Opens a batch of swap writes; see the comment on swap_map.
+ * Batches nest. */
+void
+anon_swap_batch_begin (void) {
+	if (swap_map == NULL) {
+		return;
+	}
+	lock_acquire (&swap_lock);
+	batch_depth++;
+	lock_release (&swap_lock);
+}
+
+/* Swap */
+/* Closes a batch opened by anon_swap_batch_begin(), writing out
+ * what it holds once the outermost batch closes. */
+void
+anon_swap_batch_end (void) {
+	if (swap_map == NULL) {
+		return;
+	}
+	lock_acquire (&swap_lock);
+	ASSERT (batch_depth > 0);
+	if (--batch_depth == 0) {
+		batch_flush ();
+	}
+	lock_release (&swap_lock);
+}
+
+/* Swap */
+/* Drops one reference to SLOT.  Releases it, along with any cached
+ * copy, when the last page sharing it lets go.  The caller must
+ * hold swap_lock. */
+static void
+free_slot (size_t slot) {
+	ASSERT (bitmap_test (swap_map, slot));
+	ASSERT (slot_refs[slot] > 0);
+	if (--slot_refs[slot] > 0) {
+		return;
+	}
+
+	struct ra_entry *ra = ra_lookup (slot);
+	if (ra != NULL) {
+		ra->slot = BITMAP_ERROR;
+	}
+	zswap_forget (slot);
+	bitmap_reset (swap_map, slot);
+}
+
+/* Copy on Write */
+/* Lets PAGE, a copy of a swapped-out anonymous page, share its
+ * swap slot with the original. */
+void
+anon_dup_swap_slot (struct page *page) {
+	int slot = page->anon.swap_info;
+
+	if (slot >= 0) {
+		lock_acquire (&swap_lock);
+		ASSERT (slot_refs[slot] > 0);
+		slot_refs[slot]++;
+		lock_release (&swap_lock);
+	}
+}
+
+/* Swap */
+/* Reads the CNT slots starting at FIRST into the next entries of
+ * the readahead cache, with one disk command for each part that
+ * does not wrap around the cache.  The caller must hold
+ * swap_lock. */
+static void
+ra_read (size_t first, size_t cnt) {
+	while (cnt > 0) {
+		size_t run = SWAP_RA_CACHE - ra_next < cnt
+			? SWAP_RA_CACHE - ra_next : cnt;
+
+		disk_read_multiple (swap_disk, first * SECTORS_PER_SLOT,
+				ra_cache[ra_next].kva, run * SECTORS_PER_SLOT);
+		for (size_t i = 0; i < run; i++) {
+			ra_cache[ra_next + i].slot = first + i;
+		}
+		ra_next = (ra_next + run) % SWAP_RA_CACHE;
+		first += run;
+		cnt -= run;
+	}
+}
+
+/* Swap */
+/* Reads the in-use slots that follow SLOT, up to the end of the
+ * readahead window, into the readahead cache, a run of adjacent
+ * slots at a time.  The caller must hold swap_lock. */
+static void
+read_ahead (size_t slot) {
+	size_t end = slot + SWAP_RA_WINDOW;
+	size_t first = 0, cnt = 0;
+
+	if (end > bitmap_size (swap_map)) {
+		end = bitmap_size (swap_map);
+	}
+
+	for (size_t s = slot + 1; s < end; s++) {
+		if (!bitmap_test (swap_map, s)) {
+			break;
+		}
+		/* Compressed Swap */
+		/* A slot in the compressed pool or the open batch is not up to
+		 * date on disk, and is cheap to load anyway. */
+		if (ra_lookup (s) != NULL || zswap_contains (s)
+				|| batch_lookup (s) != NULL) {
+			ra_read (first, cnt);
+			cnt = 0;
+			continue;
+		}
+		if (cnt++ == 0) {
+			first = s;
+		}
+	}
+	ra_read (first, cnt);
 }
 
 /* Initialize the file mapping */
@@ -45,16 +334,97 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+
+	/* Swap */
+	if (anon_page->swap_info < 0) {
+		return false;
+	}
+
+	size_t slot = anon_page->swap_info;
+	struct ra_entry *ra;
+
+	lock_acquire (&swap_lock);
+	ra = ra_lookup (slot);
+	if (ra != NULL) {
+		memcpy (kva, ra->kva, PGSIZE);
+		ra_hit_cnt++;
+	}
+	else if (batch_lookup (slot) != NULL) {
+		memcpy (kva, batch_lookup (slot), PGSIZE);
+	}
+	else if (!zswap_load (slot, kva)) {
+		/* Compressed Swap */
+		/* Not in the compressed pool either: go to disk. */
+		read_slot (slot, kva);
+		read_ahead (slot);
+	}
+	free_slot (slot);
+	swap_in_cnt++;
+	lock_release (&swap_lock);
+
+	anon_page->swap_info = -1;
+	vm_count_event (page->owner, VM_EV_SWAP_IN);
+	return true;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	/* Swap */
+	struct frame *frame = page->frame;
+	size_t slot;
+
+	if (swap_map == NULL) {
+		return false;
+	}
+
+	lock_acquire (&swap_lock);
+	/* Copy on Write */
+	/* A shared frame is written once; every page that maps it then
+	 * refers to the same slot. */
+	if (frame->swap_slot >= 0) {
+		slot_refs[frame->swap_slot]++;
+		lock_release (&swap_lock);
+		anon_page->swap_info = frame->swap_slot;
+		return true;
+	}
+
+	slot = bitmap_scan_and_flip (swap_map, swap_cursor, 1, false);
+	if (slot == BITMAP_ERROR) {
+		slot = bitmap_scan_and_flip (swap_map, 0, 1, false);
+	}
+	if (slot == BITMAP_ERROR) {
+		lock_release (&swap_lock);
+		return false;
+	}
+	swap_cursor = slot + 1;
+	slot_refs[slot] = 1;
+
+	/* Compressed Swap */
+	if (!zswap_store (slot, frame->kva) && !batch_add (slot, frame->kva)) {
+		write_slot (slot, frame->kva);
+	}
+	swap_out_cnt++;
+	frame->swap_slot = slot;
+	lock_release (&swap_lock);
+	vm_count_event (page->owner, VM_EV_SWAP_OUT);
+
+	anon_page->swap_info = slot;
+	return true;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	/* Swap */
+	if (anon_page->swap_info >= 0) {
+		lock_acquire (&swap_lock);
+		free_slot (anon_page->swap_info);
+		lock_release (&swap_lock);
+		anon_page->swap_info = -1;
+	}
 }
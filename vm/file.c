@@ -2,6 +2,14 @@
 
 #include "vm/vm.h"
 
+/* Memory Mapped Files */
+#include <round.h>
+#include <string.h>
+#include "filesys/inode.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
 static void file_backed_destroy (struct page *page);
@@ -14,6 +22,16 @@ static const struct page_operations file_ops = {
 	.type = VM_FILE,
 };
 
+/* Memory Mapped Files */
+/* A mapping is a VMA of type VM_FILE.  Its pages are shared: every
+ * process that maps the same part of a file maps the same frame,
+ * found through the frame cache in vm.c, so writes through one
+ * mapping are seen by the others at once.  A page is written back
+ * only if it was written through some mapping, as the dirty bits
+ * of the page tables tell, when it is evicted or unmapped. */
+
+static void write_back (struct page *page);
+
 /* The initializer of file vm */
 void
 vm_file_init (void) {
@@ -22,37 +40,235 @@ vm_file_init (void) {
 /* Initialize the file backed page */
 bool
 file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+	/* Memory Mapped Files */
+	/* Fetch the area first, since the union is overwritten below. */
+	struct vma *vma = page->uninit.aux;
+
 	/* Set up the handler */
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	file_page->file = vma->file;
+	file_page->ofs = vma_page_ofs (vma, page->va);
+	file_page->read_bytes = vma_page_read_bytes (vma, page->va);
+	return true;
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
 	struct file_page *file_page UNUSED = &page->file;
+
+	/* Memory Mapped Files */
+	if (file_read_at (file_page->file, kva, file_page->read_bytes,
+				file_page->ofs) != (off_t) file_page->read_bytes) {
+		return false;
+	}
+	vm_count_event (page->owner, VM_EV_PAGE_IN);
+	memset (kva + file_page->read_bytes, 0, PGSIZE - file_page->read_bytes);
+	return true;
 }
 
 /* Swap out the page by writeback contents to the file. */
 static bool
 file_backed_swap_out (struct page *page) {
 	struct file_page *file_page UNUSED = &page->file;
+
+	/* Memory Mapped Files */
+	write_back (page);
+	return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
 	struct file_page *file_page UNUSED = &page->file;
+
+	/* Memory Mapped Files */
+	if (page->frame != NULL) {
+		write_back (page);
+	}
+}
+
+/* Memory Mapped Files */
+/* Writes resident PAGE back to its file if it was written through
+ * its own mapping.  Other mappings of the same frame write back
+ * what they dirtied themselves. */
+static void
+write_back (struct page *page) {
+	struct file_page *file_page = &page->file;
+	uint64_t *pml4 = page->owner->pml4;
+
+	if (pml4 == NULL || !pml4_is_dirty (pml4, page->va)) {
+		return;
+	}
+	file_write_at (file_page->file, page->frame->kva, file_page->read_bytes,
+			file_page->ofs);
+	pml4_set_dirty (pml4, page->va, false);
+	vm_count_event (page->owner, VM_EV_WRITE_BACK);
 }
 
 /* Do the mmap */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	/* Memory Mapped Files */
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	size_t page_cnt = DIV_ROUND_UP (length, PGSIZE);
+	off_t file_len = file_length (file);
+	size_t read_bytes;
+	struct hash_iterator i;
+
+	if (page_cnt == 0 || file_len == 0 || offset < 0) {
+		return NULL;
+	}
+	read_bytes = offset < file_len ? (size_t) (file_len - offset) : 0;
+	if (read_bytes > page_cnt * PGSIZE) {
+		read_bytes = page_cnt * PGSIZE;
+	}
+
+	/* Pages outside any area, like the stack, must not be covered
+	 * either. */
+	hash_first (&i, &spt->hash_page);
+	while (hash_next (&i)) {
+		struct page *page = hash_entry (hash_cur (&i), struct page, hash_elem);
+
+		if (page->va >= addr && (size_t) (page->va - addr) < page_cnt * PGSIZE) {
+			return NULL;
+		}
+	}
+
+	if (vma_create (&spt->vmas, addr, page_cnt, VM_FILE, writable, file,
+				offset, read_bytes) == NULL) {
+		return NULL;
+	}
+	return addr;
 }
 
 /* Do the munmap */
 void
 do_munmap (void *addr) {
+	/* Memory Mapped Files */
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vma *vma = vma_find (&spt->vmas, addr);
+
+	if (vma == NULL || vma->start != addr || VM_TYPE (vma->type) != VM_FILE) {
+		return;
+	}
+	spt_remove_range (spt, vma->start, vma->end);
+	vma_remove (&spt->vmas, vma);
+}
+
+/* Memory Mapped Files */
+/* Writes back the pages in the LENGTH bytes at page-aligned ADDR
+ * that were written through this process's mappings.  The range
+ * must lie in mappings.  Returns 0 if successful, -1 otherwise. */
+int
+do_msync (void *addr, size_t length) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	void *end = addr + ROUND_UP (length, PGSIZE);
+	void *upage;
+
+	if (pg_ofs (addr) != 0 || end <= addr || !is_user_vaddr (end - 1)
+			|| !vma_covers (&spt->vmas, addr, end)) {
+		return -1;
+	}
+	for (upage = addr; upage < end; upage += PGSIZE) {
+		struct vma *vma = vma_find (&spt->vmas, upage);
+		struct page *page;
+
+		if (VM_TYPE (vma->type) != VM_FILE) {
+			return -1;
+		}
+		page = spt_find_page (spt, upage);
+		if (page != NULL && page->frame != NULL
+				&& VM_TYPE (page->operations->type) == VM_FILE) {
+			write_back (page);
+		}
+	}
+	return 0;
+}
+
+/* Memory Mapped Files */
+/* Reads SIZE bytes from FILE, at its current position, into user
+ * BUFFER, like file_read().  Pages that a mapping of FILE has in
+ * memory are copied from there, so read() sees writes made through
+ * mappings before they are written back, and costs no disk read. */
+off_t
+vm_file_read (struct file *file, void *buffer, off_t size) {
+	struct inode *inode = file_get_inode (file);
+	off_t length = file_length (file);
+	off_t pos = file_tell (file);
+	uint8_t *bounce = NULL;
+	off_t done = 0;
+
+	while (done < size && pos < length) {
+		off_t page_start = ROUND_DOWN (pos, PGSIZE);
+		size_t page_ofs = pos - page_start;
+		size_t read_bytes = length - page_start < PGSIZE
+			? (size_t) (length - page_start) : PGSIZE;
+		off_t chunk = read_bytes - page_ofs;
+
+		if (chunk > size - done) {
+			chunk = size - done;
+		}
+
+		/* The frame is copied out under a lock that page faults also
+		 * take, so go through a kernel buffer. */
+		if (vm_cache_copy (inode, page_start, read_bytes, page_ofs, NULL,
+					chunk, false)
+				&& (bounce != NULL || (bounce = palloc_get_page (0)) != NULL)
+				&& vm_cache_copy (inode, page_start, read_bytes, page_ofs, bounce,
+					chunk, false)) {
+			memcpy (buffer + done, bounce, chunk);
+		}
+		else if (file_read_at (file, buffer + done, chunk, pos) != chunk) {
+			break;
+		}
+		done += chunk;
+		pos += chunk;
+	}
+	file_seek (file, pos);
+	palloc_free_page (bounce);
+	return done;
+}
+
+/* Memory Mapped Files */
+/* Writes SIZE bytes from user BUFFER to FILE, at its current
+ * position, like file_write(), and updates the pages that mappings
+ * of FILE have in memory to match. */
+off_t
+vm_file_write (struct file *file, const void *buffer, off_t size) {
+	struct inode *inode = file_get_inode (file);
+	off_t length = file_length (file);
+	off_t pos = file_tell (file);
+	off_t written = file_write (file, buffer, size);
+	uint8_t *bounce = NULL;
+	off_t done = 0;
+
+	while (done < written && pos + done < length) {
+		off_t page_start = ROUND_DOWN (pos + done, PGSIZE);
+		size_t page_ofs = pos + done - page_start;
+		size_t read_bytes = length - page_start < PGSIZE
+			? (size_t) (length - page_start) : PGSIZE;
+		off_t chunk = PGSIZE - page_ofs;
+
+		if (chunk > written - done) {
+			chunk = written - done;
+		}
+		if (page_ofs + chunk > read_bytes) {
+			chunk = read_bytes - page_ofs;
+		}
+
+		if (vm_cache_copy (inode, page_start, read_bytes, page_ofs, NULL,
+					chunk, true)
+				&& (bounce != NULL || (bounce = palloc_get_page (0)) != NULL)) {
+			memcpy (bounce, buffer + done, chunk);
+			vm_cache_copy (inode, page_start, read_bytes, page_ofs, bounce,
+					chunk, true);
+		}
+		done += chunk;
+	}
+	palloc_free_page (bounce);
+	return written;
 }
@@ -0,0 +1,128 @@
+/* memcg.c: Groups of processes with a common frame limit. */
+
+#include "vm/memcg.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Every frame that holds user pages is charged to the group of the
+ * process that brought it in, until it leaves memory.  A frame
+ * shared with processes of other groups stays charged to the first.
+ * When a process of a group at its limit needs a frame, vm.c evicts
+ * one of the group's own frames for it, so that a process that
+ * outgrows its limit pages against itself rather than pushing out
+ * the pages of everyone else.  Only if the group has nothing left
+ * to evict does the frame come from the whole system.
+ *
+ * Groups live until the machine powers off.  A process joins a
+ * group with memcg_join(); the frames it has charged already stay
+ * with its old group. */
+
+static struct memcg groups[MEMCG_MAX];
+static struct lock memcg_lock;          /* Protects IN_USE and LIMIT. */
+
+/* Sets up the root group. */
+void
+memcg_init (void) {
+	lock_init (&memcg_lock);
+	for (int i = 0; i < MEMCG_MAX; i++) {
+		groups[i].id = i;
+	}
+	groups[MEMCG_ROOT].in_use = true;
+}
+
+/* Creates a group whose processes may hold LIMIT frames, or any
+ * number if LIMIT is 0.  Returns a null pointer if the table is
+ * full. */
+struct memcg *
+memcg_alloc (size_t limit) {
+	struct memcg *memcg = NULL;
+
+	lock_acquire (&memcg_lock);
+	for (int i = 0; i < MEMCG_MAX; i++) {
+		if (!groups[i].in_use) {
+			memcg = &groups[i];
+			memcg->in_use = true;
+			memcg->limit = limit;
+			break;
+		}
+	}
+	lock_release (&memcg_lock);
+	return memcg;
+}
+
+/* Returns the group with ID, or a null pointer if there is none. */
+struct memcg *
+memcg_lookup (int id) {
+	struct memcg *memcg = NULL;
+
+	if (id >= 0 && id < MEMCG_MAX) {
+		lock_acquire (&memcg_lock);
+		if (groups[id].in_use) {
+			memcg = &groups[id];
+		}
+		lock_release (&memcg_lock);
+	}
+	return memcg;
+}
+
+/* Returns the group of process T. */
+struct memcg *
+memcg_of (struct thread *t) {
+	return t->memcg != NULL ? t->memcg : &groups[MEMCG_ROOT];
+}
+
+/* Charges a frame to MEMCG.  The caller must hold frame_lock. */
+void
+memcg_charge (struct memcg *memcg) {
+	if (++memcg->usage > memcg->peak) {
+		memcg->peak = memcg->usage;
+	}
+}
+
+/* Takes back a frame charged to MEMCG.  The caller must hold
+ * frame_lock. */
+void
+memcg_uncharge (struct memcg *memcg) {
+	ASSERT (memcg->usage > 0);
+	memcg->usage--;
+}
+
+/* Returns true if MEMCG may not be charged another frame. */
+bool
+memcg_at_limit (const struct memcg *memcg) {
+	return memcg->limit != 0 && memcg->usage >= memcg->limit;
+}
+
+/* Copies the limit, charges and counters of MEMCG into STAT. */
+void
+memcg_get_stat (const struct memcg *memcg, struct memcg_stat *stat) {
+	stat->limit = memcg->limit;
+	stat->usage = memcg->usage;
+	stat->peak = memcg->peak;
+	stat->reclaim_cnt = memcg->reclaim_cnt;
+	stat->evict_cnt = memcg->evict_cnt;
+}
+
+/* Prints the charges and counters of every group. */
+void
+memcg_print_stats (void) {
+	for (int i = 0; i < MEMCG_MAX; i++) {
+		const struct memcg *memcg = &groups[i];
+
+		if (!memcg->in_use) {
+			continue;
+		}
+		printf ("Memory cgroup %d: %zu frames, peak %zu, ", i, memcg->usage,
+				memcg->peak);
+		if (memcg->limit != 0) {
+			printf ("limit %zu, ", memcg->limit);
+		}
+		else {
+			printf ("no limit, ");
+		}
+		printf ("%lld frames reclaimed in the group, %lld evicted\n",
+				memcg->reclaim_cnt, memcg->evict_cnt);
+	}
+}
@@ -0,0 +1,244 @@
+/* userfault.c: Page faults forwarded to a handler in user space. */
+
+#include "vm/userfault.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <string.h>
+#include <userfault.h>
+#include "vm/vm.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/uaccess.h"
+
+/* A process that does its own paging registers an area with a
+ * userfault object, which it reaches through a file descriptor.
+ * The area's pages are lazy like any other: the first touch of one
+ * gives it a frame and runs userfault_page_in() as its initializer.
+ * Instead of loading the page, that queues a fault and sleeps.
+ * Another process holding the descriptor, usually a child forked
+ * for the purpose, read()s the fault, produces the page however it
+ * likes, and hands it over with uffd_copy(), which fills the frame
+ * and wakes the faulting process.  From then on the page is an
+ * ordinary anonymous page, so it can be swapped out and never
+ * faults to the handler again.
+ *
+ * A process must not handle faults on its own areas, since it
+ * sleeps in them.  When the last descriptor is closed, waiting and
+ * later faults fail, and the faulting process is killed. */
+
+struct userfault {
+	struct lock lock;
+	struct condition fault_cond;    /* Signaled when a fault is queued. */
+	struct list faults;             /* Waiting faults, oldest first. */
+	int ref_cnt;                    /* Files and areas that refer to it. */
+	int file_cnt;                   /* Files, through which it is handled. */
+};
+
+/* A fault waiting for its page.  It lives on the stack of the
+ * faulting thread. */
+struct fault {
+	struct list_elem elem;          /* Element in FAULTS. */
+	struct uffd_msg msg;            /* What read() returns for it. */
+	void *kva;                      /* Frame to fill. */
+	bool delivered;                 /* Returned by read() yet? */
+	bool filled;                    /* Filled by uffd_copy()? */
+	struct semaphore done;          /* Upped when filled or failed. */
+};
+
+/* Returns a new userfault object, referred to by one file, or a
+ * null pointer if memory runs out. */
+struct userfault *
+userfault_create (void) {
+	struct userfault *uffd = malloc (sizeof *uffd);
+
+	if (uffd != NULL) {
+		lock_init (&uffd->lock);
+		cond_init (&uffd->fault_cond);
+		list_init (&uffd->faults);
+		uffd->ref_cnt = 1;
+		uffd->file_cnt = 1;
+	}
+	return uffd;
+}
+
+/* Adds a file reference to UFFD, for a duplicated file, and
+ * returns it. */
+struct userfault *
+userfault_reopen (struct userfault *uffd) {
+	lock_acquire (&uffd->lock);
+	uffd->ref_cnt++;
+	uffd->file_cnt++;
+	lock_release (&uffd->lock);
+	return uffd;
+}
+
+/* Drops a file reference to UFFD.  Once no file refers to it, no
+ * one can fill its pages, so its waiting faults fail. */
+void
+userfault_close (struct userfault *uffd) {
+	lock_acquire (&uffd->lock);
+	if (--uffd->file_cnt == 0) {
+		while (!list_empty (&uffd->faults)) {
+			struct fault *f = list_entry (list_pop_front (&uffd->faults),
+					struct fault, elem);
+
+			sema_up (&f->done);
+		}
+	}
+	lock_release (&uffd->lock);
+	userfault_put (uffd);
+}
+
+/* Drops a reference to UFFD, freeing it with the last one. */
+void
+userfault_put (struct userfault *uffd) {
+	bool last;
+
+	lock_acquire (&uffd->lock);
+	last = --uffd->ref_cnt == 0;
+	lock_release (&uffd->lock);
+	if (last) {
+		free (uffd);
+	}
+}
+
+/* Creates in SPT a writable anonymous area of LENGTH bytes at
+ * page-aligned ADDR whose faults go to UFFD.  Returns false if the
+ * range is not free or memory runs out. */
+bool
+userfault_register (struct userfault *uffd,
+		struct supplemental_page_table *spt, void *addr, size_t length) {
+	struct vma *vma;
+
+	ASSERT (pg_ofs (addr) == 0);
+
+	vma = vma_create (&spt->vmas, addr, DIV_ROUND_UP (length, PGSIZE),
+			VM_ANON, true, NULL, 0, 0);
+	if (vma == NULL) {
+		return false;
+	}
+	lock_acquire (&uffd->lock);
+	uffd->ref_cnt++;
+	lock_release (&uffd->lock);
+	vma->uffd = uffd;
+	return true;
+}
+
+/* Waits for a fault on UFFD that no handler has read yet, and
+ * stores its struct uffd_msg in BUFFER, which holds SIZE bytes.
+ * Returns the number of bytes stored, or -1 if SIZE is too small. */
+int
+userfault_read (struct userfault *uffd, void *buffer, unsigned size) {
+	struct uffd_msg msg;
+	struct list_elem *e;
+
+	if (size < sizeof msg) {
+		return -1;
+	}
+
+	lock_acquire (&uffd->lock);
+	for (;;) {
+		for (e = list_begin (&uffd->faults); e != list_end (&uffd->faults);
+				e = list_next (e)) {
+			if (!list_entry (e, struct fault, elem)->delivered) {
+				break;
+			}
+		}
+		if (e != list_end (&uffd->faults)) {
+			break;
+		}
+		cond_wait (&uffd->fault_cond, &uffd->lock);
+	}
+	list_entry (e, struct fault, elem)->delivered = true;
+	msg = list_entry (e, struct fault, elem)->msg;
+	lock_release (&uffd->lock);
+
+	memcpy (buffer, &msg, sizeof msg);
+	return sizeof msg;
+}
+
+/* Fills the pages of the LENGTH bytes at page-aligned DST, whose
+ * faults are waiting on UFFD, from the current process's memory at
+ * SRC, and wakes the processes that faulted.  Stops at the first
+ * page with no waiting fault.  Returns the number of bytes
+ * copied, or -1 if DST or LENGTH is not page-aligned or SRC is not
+ * readable. */
+int
+userfault_copy (struct userfault *uffd, void *dst, const void *src,
+		size_t length) {
+	size_t ofs;
+
+	if (pg_ofs (dst) != 0 || length == 0 || pg_ofs (length) != 0) {
+		return -1;
+	}
+
+	for (ofs = 0; ofs < length; ofs += PGSIZE) {
+		struct fault *f = NULL;
+		struct list_elem *e;
+
+		lock_acquire (&uffd->lock);
+		for (e = list_begin (&uffd->faults); e != list_end (&uffd->faults);
+				e = list_next (e)) {
+			if (list_entry (e, struct fault, elem)->msg.addr == dst + ofs) {
+				f = list_entry (e, struct fault, elem);
+				list_remove (e);
+				break;
+			}
+		}
+		lock_release (&uffd->lock);
+		if (f == NULL) {
+			break;
+		}
+
+		if (copy_from_user (f->kva, src + ofs, PGSIZE) != 0) {
+			/* SRC is not readable; the fault waits for another try. */
+			lock_acquire (&uffd->lock);
+			list_push_front (&uffd->faults, &f->elem);
+			lock_release (&uffd->lock);
+			return -1;
+		}
+		f->filled = true;
+		sema_up (&f->done);
+	}
+	return ofs;
+}
+
+/* Fills PAGE, just given a frame, by forwarding its fault to the
+ * handler of the area AUX it lies in, and waiting for it.  A page
+ * of a forked copy of the area, which has no handler, is zeroed. */
+bool
+userfault_page_in (struct page *page, void *aux) {
+	struct vma *vma = aux;
+	struct userfault *uffd = vma->uffd;
+	struct fault f;
+
+	if (uffd == NULL) {
+		memset (page->frame->kva, 0, PGSIZE);
+		return true;
+	}
+
+	f.msg.addr = page->va;
+	f.msg.pid = page->owner->tid;
+	f.kva = page->frame->kva;
+	f.delivered = false;
+	f.filled = false;
+	sema_init (&f.done, 0);
+
+	lock_acquire (&uffd->lock);
+	if (uffd->file_cnt == 0) {
+		lock_release (&uffd->lock);
+		return false;
+	}
+	list_push_back (&uffd->faults, &f.elem);
+	cond_signal (&uffd->fault_cond, &uffd->lock);
+	lock_release (&uffd->lock);
+
+	sema_down (&f.done);
+	if (f.filled) {
+		vm_count_event (page->owner, VM_EV_USER_FAULT);
+	}
+	return f.filled;
+}
@@ -12,8 +12,197 @@
 #include "userprog/process.h"
 #include "threads/vaddr.h"
 
-/* Memory management */
-struct list frame_table;
+/* Page Replacement */
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "intrinsic.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/numa.h"
+#include "vm/userfault.h"
+#include "threads/synch.h"
+
+/* Frame Cache */
+#include "filesys/inode.h"
+
+/* Madvise */
+#include <round.h>
+
+/* Memory Cgroups */
+#include "vm/memcg.h"
+
+/* Page Replacement */
+/* Frames that hold user pages, on two LRU lists, oldest first.
+ * A new frame starts on the inactive list.  If it is referenced
+ * again before it reaches the front, it is promoted to the active
+ * list.  The background scanner demotes active frames that went
+ * unreferenced for a whole scan period.  Victims come only from
+ * the inactive list, so pages touched once, as by a streaming
+ * read, cannot push out another process's hot pages.
+ *
+ * A frame is added only once its page is fully loaded, so frames
+ * being filled are never chosen for eviction. */
+static struct list active_list;
+static struct list inactive_list;
+static size_t active_cnt;
+static size_t inactive_cnt;
+static struct lock frame_lock;
+
+/* Page Out Daemon */
+/* Signaled, under frame_lock, when an eviction finishes. */
+static struct condition eviction_done;
+
+/* Period of the background scanner, in timer ticks. */
+#define SCAN_INTERVAL (TIMER_FREQ / 4)
+
+/* Swap */
+/* Number of frames reclaimed together when the user pool runs dry.
+ * Their pages go to consecutive swap slots. */
+#define RECLAIM_CLUSTER 8
+
+static long long promote_cnt;   /* # of inactive frames promoted. */
+static long long demote_cnt;    /* # of active frames demoted. */
+static long long cow_copy_cnt;  /* # of pages copied on write. */
+static void inspect_fault_cnt (struct intr_frame *);
+static void frame_scanner (void *aux);
+
+/* Page Out Daemon */
+/* When the number of free user frames drops below vm_low_wmark,
+ * vm_get_frame() wakes the "kswapd" thread, which evicts frames
+ * until vm_high_wmark are free.  Faults then usually find a free
+ * frame without evicting one themselves.  Zero means a default
+ * based on the size of the user pool. */
+size_t vm_low_wmark;
+size_t vm_high_wmark;
+static struct semaphore kswapd_sema;
+static bool kswapd_awake;
+
+static long long kswapd_wake_cnt;       /* # of times kswapd woke. */
+static long long kswapd_reclaim_cnt;    /* # of frames kswapd freed. */
+static long long direct_reclaim_cnt;    /* # of frames faults freed. */
+
+/* VM Statistics */
+/* Every enum vm_event is counted both here and for the process it
+ * happened to, and every fault resolved adds its latency to the
+ * log2 histogram of its kind, as laid out in <vmstat.h>.  The
+ * counters are not locked; a lost count now and then is harmless. */
+static long long vm_events[VM_EV_CNT];
+static long long fault_latency[VM_FAULT_KINDS][VMSTAT_BUCKETS];
+
+/* Frame Cache */
+/* Resident frames that hold pages of a file, keyed by the bytes of
+ * the file they were loaded from.  Two kinds share the cache:
+ * read-only text of executables, and pages of shared file
+ * mappings.  A process that faults on such a page, or execs a
+ * program whose text is resident, maps the cached frame instead of
+ * reading the file again, so every copy of a program shares one
+ * copy of its code and every mapping of a file sees the same
+ * bytes.  read() and write() go through the cache too.  An entry
+ * lives exactly as long as its frame stays resident.  Protected by
+ * frame_lock. */
+struct cached_frame {
+	struct hash_elem elem;
+	struct inode *inode;        /* Kept open while the entry lives. */
+	off_t ofs;                  /* Offset of the page's bytes. */
+	size_t read_bytes;          /* Bytes read; the rest are zero. */
+	bool shared;                /* Shared mapping, rather than text? */
+	struct frame *frame;        /* Frame holding them. */
+};
+static struct hash frame_cache;
+static long long cache_hit_cnt;  /* # of pages mapped from the cache. */
+
+static uint64_t cache_hash (const struct hash_elem *e, void *aux);
+static bool cache_less (const struct hash_elem *a,
+		const struct hash_elem *b, void *aux);
+static bool cache_claim (struct page *page);
+static void cache_remember (struct frame *frame, struct page *page);
+static void cache_forget (struct frame *frame);
+
+/* Fault Around */
+/* A fault on a page that still has to be read in also maps up to
+ * the thread's fault_window pages that follow it, as long as they
+ * are in the SPT and not yet loaded.  The window doubles, up to
+ * FAULT_AROUND_MAX, each time a fault lands right after the pages
+ * mapped by the previous one, and closes again on any other fault,
+ * so random access does not read pages it will not use.  Nothing
+ * is mapped ahead when free frames are short, since that would
+ * evict pages to make room for guesses.  madvise() can fix the
+ * window of an area: always full for MADV_SEQUENTIAL, always
+ * closed for MADV_RANDOM. */
+#define FAULT_AROUND_MAX 16
+static long long fault_around_cnt;  /* # of pages mapped ahead. */
+
+/* Zero Page */
+/* A read fault on an anonymous page that has never been loaded, and
+ * would be filled with nothing but zeros, maps this one frame
+ * read-only instead of a frame of its own.  The page gets a frame
+ * on its first write, through vm_handle_wp().  The zero frame is
+ * never on an LRU list, so it is never evicted. */
+static void *zero_kva;
+static long long zero_map_cnt;      /* # of read faults given the zero frame. */
+static long long zero_copy_cnt;     /* # of those pages written later. */
+
+static bool vm_map_zero (struct page *page);
+
+/* Same-Page Merging */
+/* With the -ksm option, the "ksmd" thread wakes every KSM_INTERVAL
+ * ticks and looks at up to vm_ksm_pages frames of anonymous
+ * memory.  A frame whose checksum did not change since its last
+ * look is probably not being written, so it goes into KSM_TABLE,
+ * hashed by its checksum.  If the table already holds a frame with
+ * the same bytes, the two are merged: the pages of the new one are
+ * mapped read-only to the old one, just as pages are shared after
+ * fork(), and its frame is freed.  A write to a merged page faults,
+ * and vm_handle_wp() gives the page a copy of its own again.
+ * Protected by frame_lock. */
+#define KSM_INTERVAL (TIMER_FREQ / 4)
+#define KSM_BUCKETS 256
+size_t vm_ksm_pages;
+static struct list ksm_table[KSM_BUCKETS];
+static unsigned ksm_pass = 1;       /* Current pass over all frames; never 0. */
+static long long ksm_scan_cnt;      /* # of frames looked at. */
+static long long ksm_merge_cnt;     /* # of frames freed by merging. */
+static long long ksm_split_cnt;     /* # of merged pages written later. */
+
+static void ksmd (void *aux);
+static void ksm_forget (struct frame *frame);
+
+/* Stack Growth */
+/* A process's stack is an area that starts as the page below
+ * USER_STACK and grows down on a fault, covering and mapping at
+ * once every page between the faulting one and the old bottom, so
+ * a large stack frame is one step.  A fault counts as a push only if it is at
+ * most STACK_SLACK bytes below the stack pointer.  The stack grows
+ * to at most vm_stack_pages pages, and never to within a guard page
+ * of another area.  Each growth also maps vm_stack_prefault pages
+ * below the faulting one, so a deep call chain faults less often. */
+#define STACK_SLACK 128             /* Red zone; covers PUSH and CALL. */
+#define STACK_GUARD_PAGES 1
+size_t vm_stack_pages = 256;
+size_t vm_stack_prefault;
+static long long stack_prefault_cnt; /* # of stack pages mapped ahead. */
+
+/* Madvise */
+static long long willneed_cnt;      /* # of pages loaded on MADV_WILLNEED. */
+static long long dontneed_cnt;      /* # of pages dropped on MADV_DONTNEED. */
+
+/* Populate */
+/* mmap() with MAP_POPULATE loads the pages of the new mapping
+ * right away, and so does exec of a program named in the
+ * -populate option or of a segment flagged PF_POPULATE, instead of
+ * taking a fault on each page as it is first touched.  Each page
+ * of a file is read with a single multi-sector disk command. */
+const char *vm_populate_progs;      /* Comma-separated names, or "all". */
+static long long populate_cnt;      /* # of pages loaded at mmap or exec. */
+
+static void fault_around (struct page *page);
+
+static void kswapd (void *aux);
+static void count_fault (enum vm_fault_kind kind, uint64_t start);
+static void print_fault_latency (void);
+static size_t reclaim_frames (size_t cnt);
+static void wake_kswapd (void);
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -27,7 +216,209 @@ vm_init (void) {
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
-	list_init (&frame_table);
+	/* Page Replacement */
+	list_init (&active_list);
+	list_init (&inactive_list);
+	lock_init (&frame_lock);
+	cond_init (&eviction_done);
+	thread_create ("vmscan", PRI_DEFAULT, frame_scanner, NULL);
+
+	/* Frame Cache */
+	hash_init (&frame_cache, cache_hash, cache_less, NULL);
+
+	/* Zero Page */
+	zero_kva = palloc_get_page (PAL_USER | PAL_ZERO);
+	if (zero_kva == NULL) {
+		PANIC ("vm_init: no frame for the zero page");
+	}
+
+	/* Memory Cgroups */
+	memcg_init ();
+
+	/* Same-Page Merging */
+	for (size_t i = 0; i < KSM_BUCKETS; i++) {
+		list_init (&ksm_table[i]);
+	}
+	if (vm_ksm_pages > 0) {
+		thread_create ("ksmd", PRI_DEFAULT, ksmd, NULL);
+	}
+
+	/* Page Out Daemon */
+	size_t user_pages = palloc_pool_size (PAL_USER);
+	if (vm_low_wmark == 0) {
+		vm_low_wmark = user_pages / 32 > RECLAIM_CLUSTER
+			? user_pages / 32 : RECLAIM_CLUSTER;
+	}
+	if (vm_high_wmark <= vm_low_wmark) {
+		vm_high_wmark = vm_low_wmark * 2;
+	}
+	sema_init (&kswapd_sema, 0);
+	thread_create ("kswapd", PRI_DEFAULT, kswapd, NULL);
+	intr_register_int (0x45, 3, INTR_OFF, inspect_fault_cnt,
+			"Inspect Page Fault Count");
+}
+
+/* Page Replacement */
+/* Prints paging statistics. */
+void
+vm_print_stats (void) {
+	printf ("Paging: %lld faults, %lld evictions, "
+			"%lld promotions, %lld demotions, %lld copies on write\n",
+			vm_events[VM_EV_MINOR_FAULT] + vm_events[VM_EV_MAJOR_FAULT],
+			vm_events[VM_EV_EVICT], promote_cnt, demote_cnt, cow_copy_cnt);
+
+	/* VM Statistics */
+	printf ("VM events: %lld minor faults, %lld major faults, "
+			"%lld COW faults, %lld user faults, %lld stack growths, "
+			"%lld evictions\n",
+			vm_events[VM_EV_MINOR_FAULT], vm_events[VM_EV_MAJOR_FAULT],
+			vm_events[VM_EV_COW_FAULT], vm_events[VM_EV_USER_FAULT],
+			vm_events[VM_EV_STACK_GROWTH], vm_events[VM_EV_EVICT]);
+	printf ("VM events: %lld swap-ins, %lld swap-outs, %lld page-ins, "
+			"%lld write-backs\n", vm_events[VM_EV_SWAP_IN],
+			vm_events[VM_EV_SWAP_OUT], vm_events[VM_EV_PAGE_IN],
+			vm_events[VM_EV_WRITE_BACK]);
+	vm_anon_print_stats ();
+
+	/* Page Out Daemon */
+	printf ("Reclaim: watermarks %zu/%zu pages, kswapd woke %lld times "
+			"and freed %lld frames, faults freed %lld frames\n",
+			vm_low_wmark, vm_high_wmark, kswapd_wake_cnt, kswapd_reclaim_cnt,
+			direct_reclaim_cnt);
+	print_fault_latency ();
+	printf ("Fault around: %lld pages mapped ahead\n", fault_around_cnt);
+
+	/* Zero Page */
+	printf ("Zero page: %lld read faults mapped it, %lld of those pages "
+			"written later\n", zero_map_cnt, zero_copy_cnt);
+
+	/* Same-Page Merging */
+	if (vm_ksm_pages > 0) {
+		printf ("KSM: %zu frames per %d ticks, %lld frames scanned, "
+				"%lld frames freed by merging, %lld merged pages written later\n",
+				vm_ksm_pages, KSM_INTERVAL, ksm_scan_cnt, ksm_merge_cnt,
+				ksm_split_cnt);
+	}
+
+	/* Stack Growth */
+	printf ("Stack: limit %zu pages, %lld pages prefaulted\n",
+			vm_stack_pages, stack_prefault_cnt);
+
+	/* Madvise */
+	printf ("Madvise: %lld pages loaded early, %lld pages dropped\n",
+			willneed_cnt, dontneed_cnt);
+
+	/* Populate */
+	printf ("Populate: %lld pages loaded at mmap or exec\n", populate_cnt);
+
+	/* Frame Cache */
+	printf ("Frame cache: %zu frames, %lld pages shared\n",
+			hash_size (&frame_cache), cache_hit_cnt);
+
+	/* Memory Cgroups */
+	memcg_print_stats ();
+}
+
+/* Page Out Daemon */
+/* Returns the upper bound, in cycles, of the bucket of histogram
+ * HIST that holds the PERMILLE'th permille of its TOTAL faults. */
+static uint64_t
+latency_percentile (const long long *hist, long long total, int permille) {
+	long long seen = 0;
+
+	for (int i = 0; i < VMSTAT_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen * 1000 >= total * permille) {
+			return (2ULL << i) - 1;
+		}
+	}
+	return UINT64_MAX;
+}
+
+/* VM Statistics */
+/* Counts a fault of KIND, just resolved for the current process,
+ * that began at cycle START, and adds its latency to the
+ * histogram. */
+static void
+count_fault (enum vm_fault_kind kind, uint64_t start) {
+	static const enum vm_event events[VM_FAULT_KINDS] = {
+		[VM_FAULT_MINOR] = VM_EV_MINOR_FAULT,
+		[VM_FAULT_MAJOR] = VM_EV_MAJOR_FAULT,
+		[VM_FAULT_COW] = VM_EV_COW_FAULT,
+		[VM_FAULT_USER] = VM_EV_USER_FAULT,
+	};
+	uint64_t cycles = rdtsc () - start;
+	int bucket = cycles > 0 ? 63 - __builtin_clzll (cycles) : 0;
+
+	if (bucket >= VMSTAT_BUCKETS) {
+		bucket = VMSTAT_BUCKETS - 1;
+	}
+	fault_latency[kind][bucket]++;
+	/* Userfault */
+	/* userfault_page_in() counts its faults once they are filled. */
+	if (kind != VM_FAULT_USER) {
+		vm_count_event (thread_current (), events[kind]);
+	}
+}
+
+/* Page Out Daemon */
+/* Prints percentiles of the time taken to resolve each kind of
+ * page fault. */
+static void
+print_fault_latency (void) {
+	static const char *names[VM_FAULT_KINDS] = {
+		[VM_FAULT_MINOR] = "minor",
+		[VM_FAULT_MAJOR] = "major",
+		[VM_FAULT_COW] = "COW",
+		[VM_FAULT_USER] = "user",
+	};
+
+	for (int kind = 0; kind < VM_FAULT_KINDS; kind++) {
+		const long long *hist = fault_latency[kind];
+		long long total = 0;
+
+		for (int i = 0; i < VMSTAT_BUCKETS; i++) {
+			total += hist[i];
+		}
+		if (total == 0) {
+			continue;
+		}
+		printf ("Fault latency (%s): p50 < %llu, p90 < %llu, p99 < %llu cycles\n",
+				names[kind], latency_percentile (hist, total, 500),
+				latency_percentile (hist, total, 900),
+				latency_percentile (hist, total, 990));
+	}
+}
+
+/* VM Statistics */
+/* Counts EVENT for the whole system and for T, the process it
+ * happened to, if T is not a null pointer. */
+void
+vm_count_event (struct thread *t, enum vm_event event) {
+	vm_events[event]++;
+	if (t != NULL) {
+		t->vm_events[event]++;
+	}
+}
+
+/* VM Statistics */
+/* Fills in STATS with the event counts of the whole system if
+ * GLOBAL is true, or of the current process otherwise, and with
+ * the latency histograms. */
+void
+vm_get_stats (struct vmstat *stats, bool global) {
+	memcpy (stats->events, global ? vm_events : thread_current ()->vm_events,
+			sizeof stats->events);
+	memcpy (stats->latency, fault_latency, sizeof stats->latency);
+}
+
+/* Tool for measuring page replacement.  Calling this function
+ * via int 0x45.
+ * Output:
+ *   @RAX - Number of page faults resolved so far. */
+static void
+inspect_fault_cnt (struct intr_frame *f) {
+	f->R.rax = vm_events[VM_EV_MINOR_FAULT] + vm_events[VM_EV_MAJOR_FAULT];
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -48,6 +439,13 @@ page_get_type (struct page *page) {
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame (void);
+static struct frame *evict_frame (struct frame *victim);
+static struct frame *memcg_get_frame (struct thread *owner);
+static void vm_free_frame (struct page *page);
+static bool vm_install_frame (struct page *page, struct frame *frame);
+static bool wait_for_eviction (struct page *page);
+static bool eviction_wait (struct page *page);
+static void settle_page (struct page *page);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -83,6 +481,10 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 		uninit_new (page, upage, init, type, aux, page_initializer);
 
 		page->writable = writable;
+		page->owner = thread_current ();
+		page->cache_inode = NULL;
+		page->cache_shared = false;
+		page->zero_mapped = false;
 
 		return spt_insert_page (spt, page);;
 	}
@@ -94,20 +496,60 @@ err:
 struct page *
 spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
 	/* Memory Management */
-	struct page *page = (struct page*)malloc (sizeof (struct page));
+	struct page key;
 	struct hash_elem *spt_elem;
 
-	page->va = pg_round_down (va);
+	key.va = pg_round_down (va);
 
-	spt_elem = hash_find (&spt->hash_page, &page->hash_elem);
+	spt_elem = hash_find (&spt->hash_page, &key.hash_elem);
 
 	if (spt_elem == NULL) {
-		page = NULL;
-	}
-	else {
-		page = hash_entry (spt_elem, struct page, hash_elem);
+		return NULL;
 	}
 
+	return hash_entry (spt_elem, struct page, hash_elem);
+}
+
+/* VMA */
+/* Returns the page at VA in SPT.  The first time a page of an area
+ * is asked for, its struct page is created from the area.  Returns
+ * NULL if VA is neither in SPT nor in any area. */
+struct page *
+spt_get_page (struct supplemental_page_table *spt, void *va) {
+	struct page *page = spt_find_page (spt, va);
+	void *upage = pg_round_down (va);
+	vm_initializer *init = NULL;
+	struct vma *vma;
+
+	if (page != NULL) {
+		return page;
+	}
+	vma = vma_find (&spt->vmas, upage);
+	if (vma == NULL) {
+		return NULL;
+	}
+	if (vma->file != NULL) {
+		init = vma_load_page;
+	}
+	else if (vma->uffd != NULL) {
+		/* Userfault */
+		init = userfault_page_in;
+	}
+	if (!vm_alloc_page_with_initializer (vma->type, upage, vma->writable,
+				init, vma)) {
+		return NULL;
+	}
+	page = spt_find_page (spt, upage);
+
+	/* Frame Cache */
+	/* Private writable pages must not see each other's writes. */
+	if (vma->file != NULL
+			&& (!vma->writable || VM_TYPE (vma->type) == VM_FILE)) {
+		page->cache_inode = inode_reopen (file_get_inode (vma->file));
+		page->cache_ofs = vma_page_ofs (vma, upage);
+		page->cache_read_bytes = vma_page_read_bytes (vma, upage);
+		page->cache_shared = VM_TYPE (vma->type) == VM_FILE;
+	}
 	return page;
 }
 
@@ -121,35 +563,384 @@ spt_insert_page (struct supplemental_page_table *spt UNUSED,
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
-	vm_dealloc_page (page);
-	return true;
+	vm_delete_page (&spt->hash_page, page);
+	settle_page (page);
+	destroy (page);
+	vm_free_frame (page);
+	inode_close (page->cache_inode);
+	free (page);
+}
+
+/* Range Operations */
+/* Removes the pages in [START, END) from SPT, which must belong to
+ * the current process, and returns how many there were.  Their
+ * PTEs are cleared together at the end, walking each page table
+ * once and flushing the TLB once, instead of page by page. */
+size_t
+spt_remove_range (struct supplemental_page_table *spt, void *start,
+		void *end) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	size_t cnt = 0;
+	void *upage;
+
+	spt->bulk_unmap = true;
+	for (upage = start; upage < end; upage += PGSIZE) {
+		struct page *page = spt_find_page (spt, upage);
+
+		if (page != NULL) {
+			spt_remove_page (spt, page);
+			cnt++;
+		}
+	}
+	spt->bulk_unmap = false;
+	if (pml4 != NULL) {
+		pml4_unmap_range (pml4, start, (size_t) (end - start) / PGSIZE);
+	}
+	return cnt;
+}
+
+/* Page Replacement */
+/* Adds FRAME to the back of the active or inactive list.  The
+ * caller must hold frame_lock. */
+static void
+frame_list_add (struct frame *frame, bool active) {
+	frame->active = active;
+	if (active) {
+		list_push_back (&active_list, &frame->frame_elem);
+		active_cnt++;
+	}
+	else {
+		list_push_back (&inactive_list, &frame->frame_elem);
+		inactive_cnt++;
+	}
+}
+
+/* Page Replacement */
+/* Removes FRAME from whichever list holds it.  The caller must
+ * hold frame_lock. */
+static void
+frame_list_remove (struct frame *frame) {
+	list_remove (&frame->frame_elem);
+	if (frame->active) {
+		active_cnt--;
+	}
+	else {
+		inactive_cnt--;
+	}
+}
+
+/* Copy on Write */
+/* Makes PAGE one of the pages that map FRAME, and charges it to
+ * the resident set of PAGE's process.  The caller must hold
+ * frame_lock, unless FRAME is not yet on an LRU list. */
+static void
+frame_attach (struct frame *frame, struct page *page) {
+	list_push_back (&frame->pages, &page->map_elem);
+	frame->ref_cnt++;
+	frame->page = list_entry (list_front (&frame->pages), struct page, map_elem);
+	page->frame = frame;
+	page->owner->rss_pages++;
+}
+
+/* Copy on Write */
+/* Undoes frame_attach() for PAGE, leaving its mapping alone.
+ * Returns the number of pages still mapping the frame.  The
+ * caller must hold frame_lock, unless the frame is not yet on an
+ * LRU list. */
+static int
+frame_detach (struct page *page) {
+	struct frame *frame = page->frame;
+
+	list_remove (&page->map_elem);
+	frame->ref_cnt--;
+	frame->page = frame->ref_cnt > 0
+		? list_entry (list_front (&frame->pages), struct page, map_elem)
+		: NULL;
+	page->frame = NULL;
+	page->owner->rss_pages--;
+	return frame->ref_cnt;
+}
+
+/* Memory Cgroups */
+/* Charges FRAME, just put on an LRU list, to the group of process
+ * OWNER.  The caller must hold frame_lock. */
+static void
+frame_charge (struct frame *frame, struct thread *owner) {
+	frame->memcg = memcg_of (owner);
+	memcg_charge (frame->memcg);
+}
+
+/* Memory Cgroups */
+/* Takes back the charge for FRAME, which is leaving memory.  The
+ * caller must hold frame_lock. */
+static void
+frame_uncharge (struct frame *frame) {
+	if (frame->memcg != NULL) {
+		memcg_uncharge (frame->memcg);
+		frame->memcg = NULL;
+	}
+}
+
+/* Page Replacement */
+/* Returns true if FRAME was referenced, through any of its
+ * mappings, since its accessed bits were last cleared, clearing
+ * them. */
+static bool
+frame_test_and_clear_accessed (struct frame *frame) {
+	bool accessed = false;
+
+	for (struct list_elem *e = list_begin (&frame->pages);
+			e != list_end (&frame->pages); e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, map_elem);
+		uint64_t *pml4 = page->owner->pml4;
+
+		if (pml4_is_accessed (pml4, page->va)) {
+			pml4_set_accessed (pml4, page->va, false);
+			accessed = true;
+		}
+	}
+	return accessed;
+}
+
+/* Page Replacement */
+/* Returns true if FRAME was written through any of its mappings. */
+static bool
+frame_is_dirty (struct frame *frame) {
+	for (struct list_elem *e = list_begin (&frame->pages);
+			e != list_end (&frame->pages); e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, map_elem);
+
+		if (pml4_is_dirty (page->owner->pml4, page->va)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Page Replacement */
+/* Moves the oldest active frames to the inactive list until it
+ * holds at least a third of all frames.  Frames referenced since
+ * the last look get another trip round the active list instead. */
+static void
+balance_lists (void) {
+	size_t tries = active_cnt;
+
+	while (tries-- > 0 && inactive_cnt * 2 < active_cnt) {
+		struct frame *frame = list_entry (list_front (&active_list),
+				struct frame, frame_elem);
+
+		frame_list_remove (frame);
+		if (frame_test_and_clear_accessed (frame)) {
+			frame_list_add (frame, true);
+		}
+		else {
+			frame_list_add (frame, false);
+			demote_cnt++;
+		}
+	}
+}
+
+/* Page Replacement */
+/* Returns true if FRAME is an acceptable victim in eviction pass
+ * PASS.  Earlier passes are pickier: pass 0 wants a clean page
+ * of a process holding more than its working set, pass 1 any page
+ * of such a process, and pass 2 anything. */
+static bool
+victim_ok (struct frame *frame, int pass) {
+	struct thread *owner = frame->page->owner;
+	bool over_ws = owner->rss_pages > owner->wss_pages;
+
+	switch (pass) {
+		case 0:
+			return over_ws && !frame_is_dirty (frame);
+		case 1:
+			return over_ws;
+		default:
+			return true;
+	}
 }
 
 /* Get the struct frame, that will be evicted. */
 static struct frame *
 vm_get_victim (void) {
-	struct frame *victim = NULL;
-	
-	/* Memeory Management */
-	/* TODO: The policy for eviction is up to you. */
-	victim = list_entry (list_pop_front (&frame_table), struct frame, frame_elem);
+	/* Page Replacement */
+	/* Walks the inactive list from the oldest frame.  A frame that
+	 * was referenced since it got there is promoted rather than
+	 * evicted.  When the inactive list runs dry, it is refilled
+	 * from the active list. */
+	ASSERT (lock_held_by_current_thread (&frame_lock));
+	ASSERT (active_cnt + inactive_cnt > 0);
+
+	for (int round = 0; ; round++) {
+		balance_lists ();
+		if (list_empty (&inactive_list)) {
+			/* Everything is hot: demote the oldest frame anyway. */
+			struct frame *frame = list_entry (list_front (&active_list),
+					struct frame, frame_elem);
+			frame_list_remove (frame);
+			frame_list_add (frame, false);
+			demote_cnt++;
+		}
 
-	return victim;
+		for (int pass = 0; pass < 3; pass++) {
+			struct list_elem *e = list_begin (&inactive_list);
+
+			while (e != list_end (&inactive_list)) {
+				struct frame *frame = list_entry (e, struct frame, frame_elem);
+				e = list_next (e);
+
+				if (round == 0 && frame_test_and_clear_accessed (frame)) {
+					frame_list_remove (frame);
+					frame_list_add (frame, true);
+					promote_cnt++;
+				}
+				else if (victim_ok (frame, pass)) {
+					return frame;
+				}
+			}
+		}
+	}
 }
 
 /* Evict one page and return the corresponding frame.
  * Return NULL on error.*/
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
+	return evict_frame (vm_get_victim ());
+}
 
-	/* Memory Management */
-	/* TODO: swap out the victim and return the evicted frame. */
-	swap_out (victim->page);
+/* Page Replacement */
+/* Evicts the pages of VICTIM, a frame on an LRU list, and returns
+ * it, or returns NULL if they cannot be written out.  The caller
+ * must hold frame_lock, which is released while the pages are
+ * written out. */
+static struct frame *
+evict_frame (struct frame *victim) {
+	struct list_elem *e;
+	bool written;
+
+	/* Page Replacement */
+	/* Unmap first, so that the owners fault instead of writing to
+	 * the frame while it is being written out. */
+	for (e = list_begin (&victim->pages); e != list_end (&victim->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, map_elem);
+		pml4_clear_page (page->owner->pml4, page->va);
+	}
+
+	/* Page Out Daemon */
+	/* Put the frame out of reach of the scanners, the frame cache
+	 * and ksmd, and mark it busy, so that the write needs no
+	 * frame_lock.  Anyone who wants one of its pages meanwhile waits
+	 * in eviction_wait(). */
+	ASSERT (!victim->evicting);
+	cache_forget (victim);
+	ksm_forget (victim);
+	frame_list_remove (victim);
+	victim->evicting = true;
+	lock_release (&frame_lock);
+
+	/* Copy on Write */
+	/* Every sharer gets to record where its copy went.  Only the
+	 * first can fail, since the rest share what it wrote. */
+	victim->swap_slot = -1;
+	written = swap_out (victim->page);
+	if (written) {
+		for (e = list_next (list_begin (&victim->pages));
+				e != list_end (&victim->pages); e = list_next (e)) {
+			swap_out (list_entry (e, struct page, map_elem));
+		}
+	}
+
+	lock_acquire (&frame_lock);
+	victim->evicting = false;
+	cond_broadcast (&eviction_done, &frame_lock);
+	if (!written) {
+		/* Put it back as recently used, so that the next victim is
+		 * another frame. */
+		for (e = list_begin (&victim->pages); e != list_end (&victim->pages);
+				e = list_next (e)) {
+			struct page *page = list_entry (e, struct page, map_elem);
+			pml4_set_page (page->owner->pml4, page->va, victim->kva,
+					page->writable && (victim->ref_cnt == 1 || page->cache_shared));
+		}
+		frame_list_add (victim, true);
+		return NULL;
+	}
+
+	vm_count_event (victim->page->owner, VM_EV_EVICT);
+	victim->memcg->evict_cnt++;
+	frame_uncharge (victim);
+	while (!list_empty (&victim->pages)) {
+		frame_detach (list_entry (list_front (&victim->pages),
+					struct page, map_elem));
+	}
 
 	return victim;
 }
 
+/* Page Out Daemon */
+/* Evicts up to CNT frames and returns them to the user pool.
+ * Returns the number evicted.  The caller must hold frame_lock. */
+static size_t
+reclaim_frames (size_t cnt) {
+	size_t done;
+
+	for (done = 0; done < cnt && active_cnt + inactive_cnt > 0; done++) {
+		struct frame *frame = vm_evict_frame ();
+		if (frame == NULL) {
+			break;
+		}
+		palloc_free_page (frame->kva);
+		free (frame);
+	}
+	return done;
+}
+
+/* Page Out Daemon */
+/* Wakes kswapd, unless it is already awake. */
+static void
+wake_kswapd (void) {
+	enum intr_level old_level = intr_disable ();
+
+	if (!kswapd_awake) {
+		kswapd_awake = true;
+		sema_up (&kswapd_sema);
+	}
+	intr_set_level (old_level);
+}
+
+/* Page Out Daemon */
+/* Sleeps until woken, then evicts frames in clusters until at
+ * least vm_high_wmark user frames are free or nothing is left to
+ * evict. */
+static void
+kswapd (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&kswapd_sema);
+		kswapd_wake_cnt++;
+
+		while (palloc_free_cnt (PAL_USER) < vm_high_wmark) {
+			size_t freed;
+
+			/* Swap */
+			/* The victims get adjacent swap slots, written in one go
+			 * once frame_lock is released. */
+			anon_swap_batch_begin ();
+			lock_acquire (&frame_lock);
+			freed = reclaim_frames (RECLAIM_CLUSTER);
+			lock_release (&frame_lock);
+			anon_swap_batch_end ();
+
+			kswapd_reclaim_cnt += freed;
+			if (freed == 0) {
+				break;
+			}
+		}
+		kswapd_awake = false;
+	}
+}
+
 /* palloc() and get frame. If there is no available page, evict the page
  * and return it. This always return valid address. That is, if the user pool
  * memory is full, this function evicts the frame to get the available memory
@@ -157,39 +948,586 @@ vm_evict_frame (void) {
 static struct frame *
 vm_get_frame (void) {
 	/* Memory Management */
-	struct frame *frame = (struct frame *)malloc (sizeof (struct frame));
-	
-	frame->kva = palloc_get_page (PAL_USER | PAL_ZERO);
-
-	if (frame == NULL) {
-		PANIC ("todo");
+	struct frame *frame;
+	/* Prefer memory on the node of the CPU that faulted. */
+	void *kva = palloc_get_page_node (PAL_USER | PAL_ZERO,
+			numa_current_node ());
+
+	/* Page Out Daemon */
+	if (palloc_free_cnt (PAL_USER) < vm_low_wmark) {
+		wake_kswapd ();
 	}
 
-	if (frame->kva == NULL) {
-		frame = vm_evict_frame ();
-		frame->page = NULL;
+	if (kva == NULL) {
+		/* Swap */
+		/* Evict a cluster of frames while we are at it, keeping one
+		 * and returning the rest to the user pool, so that the next
+		 * few faults need not evict and swap writes come in runs. */
+		size_t tries;
+
+		anon_swap_batch_begin ();
+		lock_acquire (&frame_lock);
+		/* Page Out Daemon */
+		/* A victim that cannot be written out, like an anonymous page
+		 * with swap full, goes back to the active list, so keep
+		 * trying others, down to clean file pages, before giving
+		 * up. */
+		frame = NULL;
+		for (tries = active_cnt + inactive_cnt;
+				frame == NULL && tries > 0 && active_cnt + inactive_cnt > 0;
+				tries--) {
+			frame = vm_evict_frame ();
+		}
+		if (frame != NULL) {
+			direct_reclaim_cnt += 1 + reclaim_frames (RECLAIM_CLUSTER - 1);
+		}
+		lock_release (&frame_lock);
+		anon_swap_batch_end ();
+
+		if (frame == NULL) {
+			PANIC ("vm_get_frame: out of frames");
+		}
+		memset (frame->kva, 0, PGSIZE);
 		return frame;
 	}
 
-	list_push_back (&frame_table, &frame->frame_elem);
+	frame = (struct frame *)malloc (sizeof (struct frame));
+	if (frame == NULL) {
+		PANIC ("vm_get_frame: out of memory");
+	}
+	frame->kva = kva;
 	frame->page = NULL;
+	list_init (&frame->pages);
+	frame->ref_cnt = 0;
+	frame->swap_slot = -1;
+	frame->cached = NULL;
+	frame->ksm_listed = false;
+	frame->ksm_merged = false;
+	frame->ksm_pass = 0;
+	frame->memcg = NULL;
+	frame->evicting = false;
+
+	return frame;
+}
+
+/* Memory Cgroups */
+/* Returns the frame of MEMCG that local reclaim evicts: the oldest
+ * one not referenced lately, looking at the inactive list before
+ * the active one, or else the oldest of them all.  Referenced
+ * inactive frames are promoted on the way, as in vm_get_victim().
+ * Returns NULL if MEMCG has no frame on the lists.  The caller must
+ * hold frame_lock. */
+static struct frame *
+memcg_get_victim (struct memcg *memcg) {
+	struct frame *oldest = NULL;
+	struct list_elem *e;
+	size_t n;
+
+	for (e = list_begin (&inactive_list), n = inactive_cnt; n > 0; n--) {
+		struct frame *frame = list_entry (e, struct frame, frame_elem);
+		e = list_next (e);
+
+		if (frame->memcg != memcg) {
+			continue;
+		}
+		if (!frame_test_and_clear_accessed (frame)) {
+			return frame;
+		}
+		frame_list_remove (frame);
+		frame_list_add (frame, true);
+		promote_cnt++;
+	}
 
-	ASSERT (frame != NULL);
-	ASSERT (frame->page == NULL);
+	for (e = list_begin (&active_list); e != list_end (&active_list);
+			e = list_next (e)) {
+		struct frame *frame = list_entry (e, struct frame, frame_elem);
 
+		if (frame->memcg != memcg) {
+			continue;
+		}
+		if (!frame_test_and_clear_accessed (frame)) {
+			return frame;
+		}
+		if (oldest == NULL) {
+			oldest = frame;
+		}
+	}
+	return oldest;
+}
+
+/* Memory Cgroups */
+/* Returns a frame for a page of process OWNER.  If OWNER's group
+ * is at its limit, that is one of the group's own frames, evicted
+ * for the purpose, so the group pages against itself.  Otherwise,
+ * or if the group has nothing it can evict, it comes from
+ * vm_get_frame(). */
+static struct frame *
+memcg_get_frame (struct thread *owner) {
+	struct memcg *memcg = memcg_of (owner);
+	struct frame *frame = NULL;
+
+	if (memcg_at_limit (memcg)) {
+		lock_acquire (&frame_lock);
+		struct frame *victim = memcg_get_victim (memcg);
+		if (victim != NULL) {
+			frame = evict_frame (victim);
+		}
+		if (frame != NULL) {
+			memcg->reclaim_cnt++;
+		}
+		lock_release (&frame_lock);
+	}
+
+	if (frame == NULL) {
+		return vm_get_frame ();
+	}
+	memset (frame->kva, 0, PGSIZE);
 	return frame;
 }
 
-/* Growing the stack. */
+/* Page Replacement */
+/* Releases the frame held by PAGE, if any, and unmaps it.  The
+ * frame itself is returned to the user pool once no other page
+ * shares it.  If the owner's SPT is in bulk_unmap mode, the PTE is
+ * left for the caller to clear. */
 static void
-vm_stack_growth (void *addr UNUSED) {
+vm_free_frame (struct page *page) {
+	bool unmap = page->owner->pml4 != NULL && !page->owner->spt.bulk_unmap;
+	struct frame *frame;
+
+	/* Zero Page */
+	if (page->zero_mapped && unmap) {
+		pml4_clear_page (page->owner->pml4, page->va);
+		page->zero_mapped = false;
+	}
+
+	/* Same-Page Merging */
+	/* ksmd may move the page to another frame until we hold the
+	 * lock. */
+	lock_acquire (&frame_lock);
+
+	/* Page Out Daemon */
+	/* An eviction that picked the frame before the caller destroyed
+	 * PAGE may have given it a swap slot since; let go of that too.
+	 * Destroying an anonymous page twice is harmless. */
+	eviction_wait (page);
+	if (page->frame == NULL) {
+		lock_release (&frame_lock);
+		if (VM_TYPE (page->operations->type) == VM_ANON) {
+			destroy (page);
+		}
+		return;
+	}
+	frame = page->frame;
+	if (frame != NULL && unmap) {
+		pml4_clear_page (page->owner->pml4, page->va);
+	}
+	if (frame == NULL || frame_detach (page) > 0) {
+		frame = NULL;
+	}
+	else {
+		cache_forget (frame);
+		ksm_forget (frame);
+		frame_list_remove (frame);
+		frame_uncharge (frame);
+	}
+	lock_release (&frame_lock);
+
+	if (frame != NULL) {
+		palloc_free_page (frame->kva);
+		free (frame);
+	}
+}
+
+/* Page Replacement */
+/* Adds up, for every process with resident frames, how many of
+ * them were referenced during the last scan period, and folds
+ * that into the process's working-set estimate.  Accessed bits
+ * of inactive frames are left set, so they can still earn a
+ * promotion in vm_get_victim().  The caller must hold frame_lock. */
+static void
+estimate_working_sets (void) {
+	struct list *lists[] = { &active_list, &inactive_list };
+	struct list_elem *e;
+	int i;
+
+	/* A shared frame counts toward the process of its first
+	 * mapping only. */
+	for (i = 0; i < 2; i++)
+		for (e = list_begin (lists[i]); e != list_end (lists[i]); e = list_next (e))
+			list_entry (e, struct frame, frame_elem)->page->owner->wss_scan = 0;
+
+	for (i = 0; i < 2; i++)
+		for (e = list_begin (lists[i]); e != list_end (lists[i]); e = list_next (e)) {
+			struct page *page = list_entry (e, struct frame, frame_elem)->page;
+			if (pml4_is_accessed (page->owner->pml4, page->va)) {
+				page->owner->wss_scan++;
+			}
+		}
+
+	/* Average with the previous estimate, so that a single quiet
+	 * period does not throw the whole working set out. */
+	for (i = 0; i < 2; i++)
+		for (e = list_begin (lists[i]); e != list_end (lists[i]); e = list_next (e)) {
+			struct thread *owner = list_entry (e, struct frame, frame_elem)->page->owner;
+			if (owner->wss_scan != SIZE_MAX) {
+				owner->wss_pages = (owner->wss_pages + owner->wss_scan + 1) / 2;
+				owner->wss_scan = SIZE_MAX;
+			}
+		}
+}
+
+/* Page Replacement */
+/* Background scanner.  Every SCAN_INTERVAL ticks, it updates the
+ * working-set estimates, then walks the active list once, giving
+ * referenced frames another period and demoting the rest. */
+static void
+frame_scanner (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (SCAN_INTERVAL);
+
+		lock_acquire (&frame_lock);
+		estimate_working_sets ();
+		for (size_t n = active_cnt; n > 0; n--) {
+			struct frame *frame = list_entry (list_front (&active_list),
+					struct frame, frame_elem);
+
+			frame_list_remove (frame);
+			if (frame_test_and_clear_accessed (frame)) {
+				frame_list_add (frame, true);
+			}
+			else {
+				frame_list_add (frame, false);
+				demote_cnt++;
+			}
+		}
+		lock_release (&frame_lock);
+	}
+}
+
+/* Same-Page Merging */
+/* Returns a checksum of the page at KVA. */
+static unsigned
+ksm_checksum (const void *kva) {
+	const uint64_t *word = kva;
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < PGSIZE / sizeof *word; i++) {
+		sum = ((sum << 7) | (sum >> 57)) ^ word[i];
+	}
+	return sum ^ (sum >> 32);
+}
+
+/* Same-Page Merging */
+/* Returns true if FRAME holds only private anonymous pages, which
+ * ksmd may merge. */
+static bool
+ksm_mergeable (struct frame *frame) {
+	if (frame->cached != NULL) {
+		return false;
+	}
+	for (struct list_elem *e = list_begin (&frame->pages);
+			e != list_end (&frame->pages); e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, map_elem);
+
+		if (VM_TYPE (page->operations->type) != VM_ANON || page->cache_shared) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Same-Page Merging */
+/* Makes every mapping of FRAME read-only, or restores write access
+ * to the pages that may write to it if RW is true. */
+static void
+ksm_protect (struct frame *frame, bool rw) {
+	for (struct list_elem *e = list_begin (&frame->pages);
+			e != list_end (&frame->pages); e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, map_elem);
+
+		pml4_protect_range (page->owner->pml4, page->va, 1,
+				rw && page->writable && frame->ref_cnt == 1);
+	}
+}
+
+/* Same-Page Merging */
+/* Takes FRAME, which is leaving memory or about to be written, out
+ * of ksm_table, and makes ksmd start over on it.  The caller must
+ * hold frame_lock. */
+static void
+ksm_forget (struct frame *frame) {
+	if (frame->ksm_listed) {
+		list_remove (&frame->ksm_elem);
+		frame->ksm_listed = false;
+	}
+	frame->ksm_merged = false;
+	frame->ksm_pass = 0;
+}
+
+/* Same-Page Merging */
+/* Maps the pages of FRAME to TARGET instead and frees FRAME, if
+ * both hold the same bytes.  Write access is taken away before
+ * comparing, so that neither can change until the pages are
+ * moved; a write in between waits for frame_lock in
+ * vm_handle_wp().  Returns true if the frames were merged.  The
+ * caller must hold frame_lock. */
+static bool
+ksm_merge (struct frame *frame, struct frame *target) {
+	if (!ksm_mergeable (target)) {
+		return false;
+	}
+	ksm_protect (frame, false);
+	ksm_protect (target, false);
+	if (memcmp (frame->kva, target->kva, PGSIZE) != 0) {
+		ksm_protect (frame, true);
+		ksm_protect (target, true);
+		return false;
+	}
+
+	while (!list_empty (&frame->pages)) {
+		struct page *page = list_entry (list_front (&frame->pages),
+				struct page, map_elem);
+
+		frame_detach (page);
+		frame_attach (target, page);
+		/* The page is mapped already, so this cannot fail. */
+		pml4_set_page (page->owner->pml4, page->va, target->kva, false);
+	}
+	target->ksm_merged = true;
+	ksm_forget (frame);
+	frame_list_remove (frame);
+	frame_uncharge (frame);
+	palloc_free_page (frame->kva);
+	free (frame);
+	ksm_merge_cnt++;
+	return true;
+}
+
+/* Same-Page Merging */
+/* Looks at FRAME once in the current pass.  If its bytes did not
+ * change since the last pass, merges it with an identical frame
+ * in ksm_table, or enters it there.  FRAME may be freed.  The
+ * caller must hold frame_lock. */
+static void
+ksm_scan_frame (struct frame *frame) {
+	unsigned checksum;
+	bool stable;
+	struct list *bucket;
+
+	ksm_scan_cnt++;
+	if (!ksm_mergeable (frame)) {
+		ksm_forget (frame);
+		frame->ksm_pass = ksm_pass;
+		return;
+	}
+
+	checksum = ksm_checksum (frame->kva);
+	stable = frame->ksm_pass != 0 && frame->ksm_checksum == checksum;
+	frame->ksm_pass = ksm_pass;
+	frame->ksm_checksum = checksum;
+	if (frame->ksm_listed) {
+		list_remove (&frame->ksm_elem);
+		frame->ksm_listed = false;
+	}
+	if (!stable) {
+		return;
+	}
+
+	bucket = &ksm_table[checksum % KSM_BUCKETS];
+	for (struct list_elem *e = list_begin (bucket); e != list_end (bucket);
+			e = list_next (e)) {
+		struct frame *target = list_entry (e, struct frame, ksm_elem);
+
+		if (target->ksm_checksum == checksum && ksm_merge (frame, target)) {
+			return;
+		}
+	}
+	list_push_back (bucket, &frame->ksm_elem);
+	frame->ksm_listed = true;
+}
+
+/* Same-Page Merging */
+/* Every KSM_INTERVAL ticks, looks at up to vm_ksm_pages frames
+ * that were not yet looked at in the current pass, starting a new
+ * pass once every frame has been. */
+static void
+ksmd (void *aux UNUSED) {
+	for (;;) {
+		struct list *lists[] = { &inactive_list, &active_list };
+		size_t budget = vm_ksm_pages;
+
+		timer_sleep (KSM_INTERVAL);
+
+		lock_acquire (&frame_lock);
+		for (int i = 0; i < 2; i++) {
+			struct list_elem *e = list_begin (lists[i]);
+
+			while (e != list_end (lists[i]) && budget > 0) {
+				struct frame *frame = list_entry (e, struct frame, frame_elem);
+				e = list_next (e);
+
+				if (frame->ksm_pass != ksm_pass) {
+					ksm_scan_frame (frame);
+					budget--;
+				}
+			}
+		}
+		if (budget > 0 && ++ksm_pass == 0) {
+			ksm_pass = 1;
+		}
+		lock_release (&frame_lock);
+	}
+}
+
+/* Growing the stack. */
+static bool
+vm_stack_growth (void *addr, void *rsp) {
 	/* Stack Growth */
-	vm_alloc_page (VM_ANON | VM_MARKER_0, addr, true);
+	/* Grows the current process's stack down to ADDR, given stack
+	 * pointer RSP, if that looks like a push.  Returns true if it
+	 * did. */
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vma *stack = vma_find (&spt->vmas, (uint8_t *) USER_STACK - PGSIZE);
+	uint8_t *limit = (uint8_t *) USER_STACK - vm_stack_pages * PGSIZE;
+	uint8_t *upage = pg_round_down (addr);
+	size_t gap = STACK_GUARD_PAGES * PGSIZE;
+	size_t prefault;
+	uint8_t *old_start, *va;
+
+	if (stack == NULL || (uint8_t *) addr + STACK_SLACK < (uint8_t *) rsp
+			|| upage < limit || upage >= (uint8_t *) stack->start) {
+		return false;
+	}
+
+	/* Cover the pages to prefault as well, if there is room. */
+	old_start = stack->start;
+	prefault = (size_t) (upage - limit) / PGSIZE;
+	if (prefault > vm_stack_prefault) {
+		prefault = vm_stack_prefault;
+	}
+	if (!vma_grow_down (&spt->vmas, stack, upage - prefault * PGSIZE, gap)) {
+		if (prefault == 0 || !vma_grow_down (&spt->vmas, stack, upage, gap)) {
+			return false;
+		}
+	}
+	vm_count_event (thread_current (), VM_EV_STACK_GROWTH);
+
+	/* The stack pointer has moved past the pages between UPAGE and
+	 * the old bottom, so they are about to be touched too. */
+	for (va = upage + PGSIZE; va < old_start; va += PGSIZE) {
+		struct page *page;
+
+		if (palloc_free_cnt (PAL_USER) <= vm_low_wmark) {
+			break;
+		}
+		page = spt_get_page (spt, va);
+		if (page != NULL && page->frame == NULL && vm_do_claim_page (page)) {
+			stack_prefault_cnt++;
+		}
+	}
+
+	for (va = upage - PGSIZE; va >= (uint8_t *) stack->start; va -= PGSIZE) {
+		struct page *page;
+
+		if (palloc_free_cnt (PAL_USER) <= vm_low_wmark) {
+			break;
+		}
+		page = spt_get_page (spt, va);
+		if (page == NULL || page->frame != NULL || !vm_do_claim_page (page)) {
+			break;
+		}
+		stack_prefault_cnt++;
+	}
+	return true;
+}
+
+/* Copy on Write */
+/* The last page sharing a frame can simply take it over, and so
+ * can a shared mapping.  Its bytes may change from now on, so ksmd
+ * must not merge with it any more.  Returns true if PAGE took its
+ * frame over.  The caller must hold frame_lock. */
+static bool
+cow_take_over (struct page *page) {
+	if (page->frame == NULL
+			|| (page->frame->ref_cnt > 1 && !page->cache_shared)) {
+		return false;
+	}
+	ksm_forget (page->frame);
+	pml4_protect_range (page->owner->pml4, page->va, 1, true);
+	return true;
 }
 
 /* Handle the fault on write_protected page */
 static bool
 vm_handle_wp (struct page *page UNUSED) {
+	/* Copy on Write */
+	uint64_t *pml4 = page->owner->pml4;
+	struct frame *frame, *old;
+
+	/* Zero Page */
+	if (page->zero_mapped) {
+		zero_copy_cnt++;
+		return vm_do_claim_page (page);
+	}
+
+	lock_acquire (&frame_lock);
+	/* Page Out Daemon */
+	eviction_wait (page);
+	if (page->frame == NULL) {
+		/* Swapped out while the fault was on its way here. */
+		lock_release (&frame_lock);
+		return vm_do_claim_page (page);
+	}
+	if (page->frame->ksm_merged) {
+		ksm_split_cnt++;
+	}
+	if (cow_take_over (page)) {
+		lock_release (&frame_lock);
+		return true;
+	}
+	lock_release (&frame_lock);
+
+	frame = memcg_get_frame (page->owner);
+
+	lock_acquire (&frame_lock);
+	eviction_wait (page);
+	if (page->frame == NULL) {
+		/* Evicted while we got the new frame: fault it back in
+		 * into a frame of its own. */
+		lock_release (&frame_lock);
+		return vm_install_frame (page, frame);
+	}
+	if (cow_take_over (page)) {
+		/* The other sharers went away while we got the new frame,
+		 * which is not needed after all. */
+		lock_release (&frame_lock);
+		palloc_free_page (frame->kva);
+		free (frame);
+		return true;
+	}
+	old = page->frame;
+	memcpy (frame->kva, old->kva, PGSIZE);
+	if (frame_detach (page) > 0) {
+		old = NULL;
+	}
+	else {
+		cache_forget (old);
+		ksm_forget (old);
+		frame_list_remove (old);
+		frame_uncharge (old);
+	}
+	frame_attach (frame, page);
+	frame_list_add (frame, false);
+	frame_charge (frame, page->owner);
+	cow_copy_cnt++;
+	lock_release (&frame_lock);
+
+	if (old != NULL) {
+		palloc_free_page (old->kva);
+		free (old);
+	}
+	return pml4_set_page (pml4, page->va, frame->kva, true);
 }
 
 /* Stack Growth */
@@ -200,27 +1538,32 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
 	struct page *page = NULL;
 	void *rsp = NULL;
+	uint64_t start = rdtsc ();
 
-	void *upage = pg_round_down (addr);
-
-	void *stack_start = USER_STACK;
-	void *stack_end = stack_start - (1 << 20);
-
-	if (is_kernel_vaddr (addr) || addr == NULL || !not_present) {
+	if (is_kernel_vaddr (addr) || addr == NULL) {
 		return false;
 	}
 
+	/* Copy on Write */
+	if (!not_present) {
+		page = write ? spt_find_page (spt, addr) : NULL;
+		if (page == NULL || !page->writable || !vm_handle_wp (page)) {
+			return false;
+		}
+		count_fault (VM_FAULT_COW, start);
+		return true;
+	}
+
 	/* TODO: Validate the fault */
 	/* TODO: Your code goes here */
 	if (not_present) {
-		rsp = is_kernel_vaddr (f->rsp) ? thread_current ()->rsp : f->rsp;
+		rsp = is_kernel_vaddr (f->rsp) ? thread_current ()->rsp : (void *) f->rsp;
 
-		if (upage >= stack_end && upage < stack_start && f->rsp == (uint64_t) addr) {
-			vm_stack_growth (upage);
+		page = spt_get_page (spt, addr);
+		if (page == NULL && vm_stack_growth (addr, rsp)) {
+			page = spt_get_page (spt, addr);
 		}
 
-		page = spt_find_page (spt, addr);
-
 		if (page == NULL) {
 			return false;
 		}
@@ -229,12 +1572,239 @@ vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
 			return false;
 		}
 
-		return vm_do_claim_page (page);
+		/* Zero Page */
+		if (!write && vm_map_zero (page)) {
+			count_fault (VM_FAULT_MINOR, start);
+			return true;
+		}
+
+		/* Fault Around */
+		enum vm_type type = VM_TYPE (page->operations->type);
+
+		/* Userfault */
+		/* Pages of a userfault area are only loaded when touched. */
+		bool forwarded = type == VM_UNINIT
+			&& page->uninit.init == userfault_page_in;
+
+		/* VM Statistics */
+		/* A fault is major if it, or the pages mapped around it, had
+		 * to be read in. */
+		long long *events = thread_current ()->vm_events;
+		long long reads = events[VM_EV_SWAP_IN] + events[VM_EV_PAGE_IN];
+
+		if (!vm_do_claim_page (page)) {
+			return false;
+		}
+		if (forwarded) {
+			count_fault (VM_FAULT_USER, start);
+			return true;
+		}
+		if (type == VM_UNINIT || type == VM_FILE) {
+			fault_around (page);
+		}
+		count_fault (events[VM_EV_SWAP_IN] + events[VM_EV_PAGE_IN] > reads
+				? VM_FAULT_MAJOR : VM_FAULT_MINOR, start);
+		return true;
 	}
 
 	return false;
 }
 
+/* Fault Around */
+/* Sizes the current thread's window from where PAGE, just
+ * claimed, lies relative to its last fault, then maps the pages
+ * that follow PAGE, up to the window.  Only file pages whose bytes
+ * already sit in the frame cache are mapped: anything else would
+ * cost a fresh frame, and maybe a disk read, for a page that might
+ * never be touched. */
+static void
+fault_around (struct page *page) {
+	struct thread *curr = thread_current ();
+	struct vma *vma = vma_find (&curr->spt.vmas, page->va);
+	int advice = vma != NULL ? vma->advice : MADV_NORMAL;
+	size_t i;
+
+	/* Madvise */
+	if (advice == MADV_SEQUENTIAL) {
+		curr->fault_window = FAULT_AROUND_MAX;
+	}
+	else if (advice == MADV_RANDOM) {
+		curr->fault_window = 0;
+	}
+	else if (page->va == curr->fault_next) {
+		curr->fault_window = curr->fault_window == 0 ? 1
+			: curr->fault_window * 2 < FAULT_AROUND_MAX
+			? curr->fault_window * 2 : FAULT_AROUND_MAX;
+	}
+	else {
+		curr->fault_window = 0;
+	}
+
+	for (i = 1; i <= curr->fault_window; i++) {
+		void *va = page->va + i * PGSIZE;
+		struct page *next;
+		enum vm_type type;
+
+		next = spt_get_page (&curr->spt, va);
+		if (next == NULL || next->zero_mapped) {
+			break;
+		}
+		type = VM_TYPE (next->operations->type);
+		if (next->frame != NULL || next->cache_inode == NULL
+				|| (type != VM_UNINIT && type != VM_FILE)) {
+			continue;
+		}
+		if (cache_claim (next)) {
+			fault_around_cnt++;
+		}
+	}
+	curr->fault_next = page->va + i * PGSIZE;
+}
+
+/* Zero Page */
+/* Returns true if PAGE has never been loaded and would be loaded
+ * with nothing but zeros. */
+static bool
+page_is_zero_fill (struct page *page) {
+	struct uninit_page *uninit = &page->uninit;
+
+	if (VM_TYPE (page->operations->type) != VM_UNINIT
+			|| VM_TYPE (uninit->type) != VM_ANON) {
+		return false;
+	}
+	if (uninit->init == NULL) {
+		return true;
+	}
+	return uninit->init == vma_load_page
+		&& vma_page_read_bytes (uninit->aux, page->va) == 0;
+}
+
+/* Zero Page */
+/* Maps PAGE, for a read fault, to the zero frame if it can be.
+ * Returns true if it did. */
+static bool
+vm_map_zero (struct page *page) {
+	if (!page_is_zero_fill (page)
+			|| !pml4_set_page (page->owner->pml4, page->va, zero_kva, false)) {
+		return false;
+	}
+	page->zero_mapped = true;
+	zero_map_cnt++;
+	return true;
+}
+
+/* Madvise */
+/* Loads the pages in [ADDR, END) of the current process's areas
+ * that are not in memory yet, while free frames last.  Returns
+ * the number loaded. */
+static size_t
+load_range (void *addr, void *end) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	size_t cnt = 0;
+
+	for (void *upage = addr; upage < end; upage += PGSIZE) {
+		struct page *page;
+
+		if (palloc_free_cnt (PAL_USER) <= vm_low_wmark) {
+			break;
+		}
+		page = spt_get_page (spt, upage);
+		if (page != NULL && page->frame == NULL && vm_do_claim_page (page)) {
+			cnt++;
+		}
+	}
+	return cnt;
+}
+
+/* Populate */
+/* Loads the pages in [ADDR, END), page-aligned, of an area just
+ * made by the loader or mmap(), so that touching them takes no
+ * faults.  Stops early if free frames run low.  Returns the number
+ * of pages loaded. */
+size_t
+vm_populate (void *addr, void *end) {
+	size_t cnt;
+
+	ASSERT (pg_ofs (addr) == 0 && pg_ofs (end) == 0);
+
+	cnt = load_range (addr, end);
+	populate_cnt += cnt;
+	return cnt;
+}
+
+/* Populate */
+/* Returns true if the -populate option names PROG, so that exec
+ * of it loads all of its segments. */
+bool
+vm_populate_exec (const char *prog) {
+	const char *p = vm_populate_progs;
+	size_t len = strlen (prog);
+
+	if (p == NULL) {
+		return false;
+	}
+	if (!strcmp (p, "all")) {
+		return true;
+	}
+	for (;;) {
+		const char *comma = strchr (p, ',');
+		size_t n = comma != NULL ? (size_t) (comma - p) : strlen (p);
+
+		if (n == len && !memcmp (p, prog, len)) {
+			return true;
+		}
+		if (comma == NULL) {
+			return false;
+		}
+		p = comma + 1;
+	}
+}
+
+/* Madvise */
+/* Applies ADVICE, one of the MADV_* values, to the LENGTH bytes at
+ * page-aligned ADDR, which must lie in areas made by the loader or
+ * mmap().  Access-pattern advice sets the fault-around window of
+ * every area the range touches.  MADV_WILLNEED loads the range's
+ * pages now, while free frames last.  It does so in the caller
+ * rather than handing the range to a kernel thread: nothing but
+ * the owning thread may touch a supplemental page table, which
+ * has no lock of its own.  MADV_DONTNEED drops the pages;
+ * they are read again from their file, or come back zeroed, when
+ * next touched.  Returns 0 if successful, -1 otherwise. */
+int
+vm_madvise (void *addr, size_t length, int advice) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	void *end = addr + ROUND_UP (length, PGSIZE);
+	struct vma *vma;
+
+	if (pg_ofs (addr) != 0 || end <= addr || !is_user_vaddr (end - 1)
+			|| !vma_covers (&spt->vmas, addr, end)) {
+		return -1;
+	}
+
+	switch (advice) {
+		case MADV_NORMAL:
+		case MADV_RANDOM:
+		case MADV_SEQUENTIAL:
+			for (vma = vma_first_in (&spt->vmas, addr, end);
+					vma != NULL && vma->start < end; vma = vma_next (&spt->vmas, vma)) {
+				vma->advice = advice;
+			}
+			return 0;
+
+		case MADV_WILLNEED:
+			willneed_cnt += load_range (addr, end);
+			return 0;
+
+		case MADV_DONTNEED:
+			dontneed_cnt += spt_remove_range (spt, addr, end);
+			return 0;
+
+		default:
+			return -1;
+	}
+}
+
 /* Free the page.
  * DO NOT MODIFY THIS FUNCTION. */
 void
@@ -251,7 +1821,7 @@ vm_claim_page (void *va UNUSED) {
 	/* Memory Management */
 	/* TODO: Fill this function */
 	struct supplemental_page_table *spt = &thread_current ()->spt;
-	page = spt_find_page (spt, va);
+	page = spt_get_page (spt, va);
 	if (page == NULL) {
 		return false;
 	}
@@ -262,26 +1832,288 @@ vm_claim_page (void *va UNUSED) {
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
-	
-	/* Memory Management */
-	struct thread *curr = thread_current ();
+	/* Zero Page */
+	if (page->zero_mapped) {
+		pml4_clear_page (page->owner->pml4, page->va);
+		page->zero_mapped = false;
+	}
+
+	/* Page Out Daemon */
+	if (wait_for_eviction (page)) {
+		return true;
+	}
 
+	/* Frame Cache */
+	if (page->cache_inode != NULL && cache_claim (page)) {
+		return true;
+	}
+	return vm_install_frame (page, memcg_get_frame (page->owner));
+}
+
+/* Page Out Daemon */
+/* Waits until PAGE is not being evicted.  Eviction unmaps a page
+ * before writing it out, so its owner can fault on it while the
+ * write is under way, with the page still on its frame.  If PAGE
+ * still has a frame once the write is over, because the write
+ * failed or the page was never evicted, maps it again, read-only
+ * so that a write goes through vm_handle_wp(), and returns true.
+ * Otherwise the caller must load the page into a new frame. */
+static bool
+wait_for_eviction (struct page *page) {
+	bool resident;
+
+	lock_acquire (&frame_lock);
+	eviction_wait (page);
+	resident = page->frame != NULL;
+	if (resident) {
+		pml4_set_page (page->owner->pml4, page->va, page->frame->kva, false);
+	}
+	lock_release (&frame_lock);
+	return resident;
+}
+
+/* Page Out Daemon */
+/* Waits while PAGE's frame is being evicted, which ends with PAGE
+ * either back on the frame or swapped out.  Returns true if it had
+ * to wait.  The caller must hold frame_lock, which is released
+ * while waiting. */
+static bool
+eviction_wait (struct page *page) {
+	bool waited = false;
+
+	while (page->frame != NULL && page->frame->evicting) {
+		cond_wait (&eviction_done, &frame_lock);
+		waited = true;
+	}
+	return waited;
+}
+
+/* Page Out Daemon */
+/* Waits for an eviction of PAGE's frame to finish before PAGE is
+ * destroyed, so that the destructor sees where the page ended up. */
+static void
+settle_page (struct page *page) {
+	lock_acquire (&frame_lock);
+	eviction_wait (page);
+	lock_release (&frame_lock);
+}
+
+/* Loads PAGE into the unused FRAME and maps it. */
+static bool
+vm_install_frame (struct page *page, struct frame *frame) {
 	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	frame_attach (frame, page);
+
+	/* Page Replacement */
+	/* Fill the frame before mapping it, and only then make it a
+	 * candidate for eviction. */
+	if (!swap_in (page, frame->kva)
+			|| !pml4_set_page (page->owner->pml4, page->va, frame->kva,
+				page->writable)) {
+		frame_detach (page);
+		palloc_free_page (frame->kva);
+		free (frame);
+		return false;
+	}
 
-	/* Memory Management */
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
-	pml4_set_page (curr->pml4, page->va, frame->kva, page->writable);
+	lock_acquire (&frame_lock);
+	frame_list_add (frame, false);
+	frame_charge (frame, page->owner);
+	if (page->cache_inode != NULL) {
+		cache_remember (frame, page);
+	}
+	lock_release (&frame_lock);
+
+	return true;
+}
+
+/* Frame Cache */
+/* Maps every page of VMA, a read-only area just set up by the
+ * loader, whose text another process has resident, so exec of a
+ * running program does not fault on it. */
+void
+vm_share_text (struct vma *vma) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct cached_frame key;
+	void *upage;
+
+	ASSERT (vma->file != NULL && !vma->writable);
+
+	key.inode = file_get_inode (vma->file);
+	key.shared = false;
+	for (upage = vma->start; upage < vma->end; upage += PGSIZE) {
+		struct page *page;
+		bool cached;
+
+		key.ofs = vma_page_ofs (vma, upage);
+		key.read_bytes = vma_page_read_bytes (vma, upage);
+		lock_acquire (&frame_lock);
+		cached = hash_find (&frame_cache, &key.elem) != NULL;
+		lock_release (&frame_lock);
+
+		if (cached && (page = spt_get_page (spt, upage)) != NULL) {
+			cache_claim (page);
+		}
+	}
+}
+
+/* Frame Cache */
+/* Maps PAGE to the cached frame holding its bytes, if there is
+ * one, dropping the page's own unloaded or swapped-out copy.
+ * Returns true if it did. */
+static bool
+cache_claim (struct page *page) {
+	struct cached_frame key;
+	struct hash_elem *e;
+	struct frame *frame;
+
+	key.inode = page->cache_inode;
+	key.ofs = page->cache_ofs;
+	key.read_bytes = page->cache_read_bytes;
+	key.shared = page->cache_shared;
+
+	lock_acquire (&frame_lock);
+	e = hash_find (&frame_cache, &key.elem);
+	if (e == NULL) {
+		lock_release (&frame_lock);
+		return false;
+	}
+	frame = hash_entry (e, struct cached_frame, elem)->frame;
+	if (!pml4_set_page (page->owner->pml4, page->va, frame->kva,
+				page->writable)) {
+		lock_release (&frame_lock);
+		return false;
+	}
 
-	return swap_in (page, frame->kva);
+	switch (VM_TYPE (page->operations->type)) {
+		case VM_UNINIT:
+			page->uninit.page_initializer (page, page->uninit.type, frame->kva);
+			break;
+		case VM_ANON:
+			destroy (page);
+			break;
+	}
+	frame_attach (frame, page);
+	cache_hit_cnt++;
+	lock_release (&frame_lock);
+
+	return true;
+}
+
+/* Frame Cache */
+/* Enters FRAME, just filled with PAGE's bytes, into the cache,
+ * unless another process loaded the same bytes first.  The caller
+ * must hold frame_lock. */
+static void
+cache_remember (struct frame *frame, struct page *page) {
+	struct cached_frame *t = malloc (sizeof *t);
+
+	if (t == NULL) {
+		return;
+	}
+	t->inode = page->cache_inode;
+	t->ofs = page->cache_ofs;
+	t->read_bytes = page->cache_read_bytes;
+	t->shared = page->cache_shared;
+	t->frame = frame;
+
+	if (hash_insert (&frame_cache, &t->elem) != NULL) {
+		free (t);
+		return;
+	}
+	inode_reopen (t->inode);
+	frame->cached = t;
+}
+
+/* Frame Cache */
+/* Removes FRAME, which is leaving memory, from the cache.
+ * The caller must hold frame_lock. */
+static void
+cache_forget (struct frame *frame) {
+	struct cached_frame *t = frame->cached;
+
+	if (t == NULL) {
+		return;
+	}
+	hash_delete (&frame_cache, &t->elem);
+	inode_close (t->inode);
+	free (t);
+	frame->cached = NULL;
+}
+
+/* Frame Cache */
+static uint64_t
+cache_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct cached_frame *t = hash_entry (e, struct cached_frame, elem);
+
+	return hash_bytes (&t->inode, sizeof t->inode) ^ hash_int (t->ofs);
+}
+
+/* Frame Cache */
+static bool
+cache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct cached_frame *a = hash_entry (a_, struct cached_frame, elem);
+	const struct cached_frame *b = hash_entry (b_, struct cached_frame, elem);
+
+	if (a->inode != b->inode) {
+		return a->inode < b->inode;
+	}
+	if (a->ofs != b->ofs) {
+		return a->ofs < b->ofs;
+	}
+	if (a->read_bytes != b->read_bytes) {
+		return a->read_bytes < b->read_bytes;
+	}
+	return a->shared < b->shared;
+}
+
+/* Frame Cache */
+/* If a shared mapping of INODE has the page at OFS, holding
+ * READ_BYTES bytes, resident, copies SIZE bytes between kernel
+ * buffer BUF and that page at PAGE_OFS, into the page if TO_FRAME
+ * is true.  Returns false, copying nothing, if it is not
+ * resident.  If BUF is a null pointer, only checks. */
+bool
+vm_cache_copy (struct inode *inode, off_t ofs, size_t read_bytes,
+		size_t page_ofs, void *buf, size_t size, bool to_frame) {
+	struct cached_frame key;
+	struct hash_elem *e;
+
+	ASSERT (page_ofs + size <= PGSIZE);
+
+	key.inode = inode;
+	key.ofs = ofs;
+	key.read_bytes = read_bytes;
+	key.shared = true;
+
+	lock_acquire (&frame_lock);
+	e = hash_find (&frame_cache, &key.elem);
+	if (e != NULL && buf != NULL) {
+		void *kva = hash_entry (e, struct cached_frame, elem)->frame->kva;
+
+		if (to_frame) {
+			memcpy (kva + page_ofs, buf, size);
+		}
+		else {
+			memcpy (buf, kva + page_ofs, size);
+		}
+	}
+	lock_release (&frame_lock);
+
+	return e != NULL;
 }
 
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
 	hash_init (&spt->hash_page, vm_hash_func, vm_less_func, NULL);	
+
+	/* VMA */
+	vma_tree_init (&spt->vmas);
+
+	/* Range Operations */
+	spt->bulk_unmap = false;
 }
 
 /* Copy supplemental page table from src to dst */
@@ -289,35 +2121,89 @@ bool
 supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
 		struct supplemental_page_table *src UNUSED) {
 	
-	/* Anonymous Page */
+	/* Copy on Write */
+	/* Resident pages are not copied.  Parent and child share their
+	 * frames read-only until one of them writes, and vm_handle_wp()
+	 * makes the copy then.  Swapped-out pages share their slot. */
 	struct thread *curr = thread_current ();
 	struct hash_iterator iter;
 
+	/* VMA */
+	if (!vma_tree_copy (&dst->vmas, &src->vmas)) {
+		return false;
+	}
+
 	hash_first (&iter, &src->hash_page);
 
 	while (hash_next (&iter)) {
 		struct page *parent_page = hash_entry (hash_cur (&iter), struct page, hash_elem);
-		enum vm_type parent_type = parent_page->operations->type;
-		void *upage = parent_page->va;
-		bool writable = parent_page->writable;
-
-		if (parent_type == VM_UNINIT) {
-			vm_initializer *init = parent_page->uninit.init;
-			void *aux = parent_page->uninit.aux;
-			vm_alloc_page_with_initializer (VM_ANON, upage, writable, init, aux);
-			continue;
-		}
-		
-		if (!vm_alloc_page (parent_type, upage, writable)) {
+		struct page *child_page = malloc (sizeof *child_page);
+
+		if (child_page == NULL) {
 			return false;
 		}
+		*child_page = *parent_page;
+		child_page->owner = curr;
+		child_page->frame = NULL;
+		inode_reopen (child_page->cache_inode);
+
+		/* VMA */
+		/* A page not loaded yet must load from the child's copy of
+		 * its area, which outlives the parent's.  A copy of a
+		 * userfault area has no handler, so its pages come zeroed. */
+		if (VM_TYPE (child_page->operations->type) == VM_UNINIT
+				&& (child_page->uninit.init == vma_load_page
+					|| child_page->uninit.init == userfault_page_in)) {
+			child_page->uninit.aux = vma_find (&dst->vmas, child_page->va);
+		}
+		else if (VM_TYPE (child_page->operations->type) == VM_FILE) {
+			child_page->file.file = vma_find (&dst->vmas, child_page->va)->file;
+		}
 
-		if (!vm_claim_page (upage)) {
+		/* Insert before sharing anything, so that a failure here has
+		 * nothing to undo but the copy itself. */
+		if (!spt_insert_page (dst, child_page)) {
+			inode_close (child_page->cache_inode);
+			free (child_page);
 			return false;
 		}
 
-		struct page *child_page = spt_find_page (dst, upage);
-		memcpy (child_page->frame->kva, parent_page->frame->kva, PGSIZE);
+		lock_acquire (&frame_lock);
+		/* Page Out Daemon */
+		eviction_wait (parent_page);
+		if (parent_page->frame != NULL) {
+			struct frame *frame = parent_page->frame;
+			bool writable = false;
+
+			/* Memory Mapped Files */
+			/* Shared mappings stay shared, with no copy on write. */
+			frame_attach (frame, child_page);
+			if (parent_page->cache_shared) {
+				writable = parent_page->writable;
+			}
+			else {
+				pml4_protect_range (parent_page->owner->pml4, parent_page->va, 1, false);
+			}
+			if (!pml4_set_page (curr->pml4, child_page->va, frame->kva, writable)) {
+				frame_detach (child_page);
+				lock_release (&frame_lock);
+				vm_delete_page (&dst->hash_page, child_page);
+				inode_close (child_page->cache_inode);
+				free (child_page);
+				return false;
+			}
+		}
+		else if (parent_page->zero_mapped) {
+			/* Zero Page */
+			child_page->zero_mapped = pml4_set_page (curr->pml4, child_page->va,
+					zero_kva, false);
+		}
+		else if (VM_TYPE (parent_page->operations->type) == VM_ANON) {
+			/* The page may have been swapped out since it was copied. */
+			child_page->anon = parent_page->anon;
+			anon_dup_swap_slot (child_page);
+		}
+		lock_release (&frame_lock);
 	}
 
 	return true;
@@ -329,7 +2215,27 @@ supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
 	/* Anonymous Page */
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
+	/* Range Operations */
+	/* Every PTE is cleared once all the pages are gone, an area at a
+	 * time, rather than page by page as each goes.  Until then
+	 * nothing can reach this address space: the process is exiting
+	 * and its pages no longer hang off any frame. */
+	uint64_t *pml4 = thread_current ()->pml4;
+	struct vma *vma;
+
+	spt->bulk_unmap = true;
 	hash_clear (&spt->hash_page, hash_page_destroy);
+	spt->bulk_unmap = false;
+	if (pml4 != NULL) {
+		for (vma = vma_first_in (&spt->vmas, NULL, (void *) KERN_BASE);
+				vma != NULL; vma = vma_next (&spt->vmas, vma)) {
+			pml4_unmap_range (pml4, vma->start,
+					(size_t) (vma->end - vma->start) / PGSIZE);
+		}
+	}
+
+	/* VMA */
+	vma_tree_destroy (&spt->vmas);
 }
 
 /* Memory Management */
@@ -379,6 +2285,9 @@ vm_delete_page (struct hash *pages, struct page *p) {
 void 
 hash_page_destroy (struct hash_elem *elem, void *aux) {
 	struct page *page = hash_entry (elem, struct page, hash_elem);
+	settle_page (page);
 	destroy (page);
+	vm_free_frame (page);
+	inode_close (page->cache_inode);
 	free (page);
 }
\ No newline at end of file
@@ -0,0 +1,358 @@
+/* vma.c: Virtual memory areas, the ranges that make up an address space. */
+
+#include "vm/vm.h"
+#include "vm/vma.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "vm/userfault.h"
+
+/* The areas of an address space are kept in an AVL tree ordered by
+ * start address.  Since areas never overlap, ordering them by end
+ * address gives the same order, which is what lookups use: the
+ * area holding VA, if any, is the first one that ends above VA. */
+
+static struct vma *insert (struct vma *node, struct vma *vma);
+static struct vma *erase (struct vma *node, struct vma *vma);
+static struct vma *first_ending_above (const struct vma_tree *tree,
+		const void *va);
+static bool copy_subtree (struct vma_tree *dst, const struct vma *node);
+static void destroy_subtree (struct vma *node);
+
+/* Initializes TREE as empty. */
+void
+vma_tree_init (struct vma_tree *tree) {
+	tree->root = NULL;
+	tree->cnt = 0;
+}
+
+/* Adds to DST a copy of every area of SRC, for fork().  Returns
+ * false if memory runs out, leaving DST partly filled. */
+bool
+vma_tree_copy (struct vma_tree *dst, const struct vma_tree *src) {
+	return copy_subtree (dst, src->root);
+}
+
+/* Frees every area of TREE.  Pages created from them are not
+ * touched. */
+void
+vma_tree_destroy (struct vma_tree *tree) {
+	destroy_subtree (tree->root);
+	vma_tree_init (tree);
+}
+
+/* Creates an area of PAGE_CNT pages at START in TREE.  If FILE is
+ * nonnull, the first READ_BYTES bytes of the area come from FILE
+ * starting at OFS, and the rest are zero; the area keeps a file of
+ * its own, so FILE may be closed afterwards.  Returns the new area,
+ * or NULL if it would overlap an existing one or memory runs out. */
+struct vma *
+vma_create (struct vma_tree *tree, void *start, size_t page_cnt,
+		enum vm_type type, bool writable, struct file *file, off_t ofs,
+		size_t read_bytes) {
+	void *end = start + page_cnt * PGSIZE;
+	struct vma *vma;
+
+	ASSERT (pg_ofs (start) == 0);
+	ASSERT (read_bytes <= page_cnt * PGSIZE);
+
+	if (page_cnt == 0 || end <= start || !is_user_vaddr (end - 1)
+			|| vma_first_in (tree, start, end) != NULL) {
+		return NULL;
+	}
+
+	vma = malloc (sizeof *vma);
+	if (vma == NULL) {
+		return NULL;
+	}
+	vma->start = start;
+	vma->end = end;
+	vma->type = type;
+	vma->writable = writable;
+	vma->file = NULL;
+	vma->ofs = ofs;
+	vma->read_bytes = file != NULL ? read_bytes : 0;
+	vma->advice = MADV_NORMAL;
+	vma->uffd = NULL;
+	if (file != NULL && (vma->file = file_reopen (file)) == NULL) {
+		free (vma);
+		return NULL;
+	}
+
+	vma->left = vma->right = NULL;
+	vma->height = 1;
+	tree->root = insert (tree->root, vma);
+	tree->cnt++;
+	return vma;
+}
+
+/* Removes VMA from TREE and frees it.  The caller must already
+ * have removed any pages created from it. */
+void
+vma_remove (struct vma_tree *tree, struct vma *vma) {
+	tree->root = erase (tree->root, vma);
+	tree->cnt--;
+	file_close (vma->file);
+	if (vma->uffd != NULL) {
+		userfault_put (vma->uffd);
+	}
+	free (vma);
+}
+
+/* Returns the area of TREE that contains VA, or NULL. */
+struct vma *
+vma_find (const struct vma_tree *tree, const void *va) {
+	struct vma *vma = first_ending_above (tree, va);
+
+	return vma != NULL && vma->start <= va ? vma : NULL;
+}
+
+/* Returns the lowest area of TREE that overlaps [START, END), or
+ * NULL.  Use vma_next() to walk through the rest. */
+struct vma *
+vma_first_in (const struct vma_tree *tree, const void *start,
+		const void *end) {
+	struct vma *vma = first_ending_above (tree, start);
+
+	return vma != NULL && vma->start < end ? vma : NULL;
+}
+
+/* Moves the start of VMA, an area with no file, down to START.
+ * Fails, returning false, if another area of TREE lies between
+ * START and VMA or less than GAP bytes below START.  The order of
+ * the areas does not change, so the tree needs no rebalancing. */
+bool
+vma_grow_down (struct vma_tree *tree, struct vma *vma, void *start,
+		size_t gap) {
+	ASSERT (vma->file == NULL);
+	ASSERT (pg_ofs (start) == 0 && start < vma->start);
+
+	if (vma_first_in (tree, (uint8_t *) start - gap, vma->start) != NULL) {
+		return false;
+	}
+	vma->start = start;
+	return true;
+}
+
+/* Returns the area of TREE that follows VMA, or NULL. */
+struct vma *
+vma_next (const struct vma_tree *tree, const struct vma *vma) {
+	return first_ending_above (tree, vma->end);
+}
+
+/* Returns true if every page in [START, END) lies in some area of
+ * TREE. */
+bool
+vma_covers (const struct vma_tree *tree, const void *start,
+		const void *end) {
+	const struct vma *vma;
+
+	for (vma = vma_first_in (tree, start, end); vma != NULL && start < end;
+			vma = vma_next (tree, vma)) {
+		if (vma->start > start) {
+			return false;
+		}
+		start = vma->end;
+	}
+	return start >= end;
+}
+
+/* Returns the offset in VMA's file of the page at UPAGE. */
+off_t
+vma_page_ofs (const struct vma *vma, const void *upage) {
+	return vma->ofs + (upage - vma->start);
+}
+
+/* Returns how many bytes of the page at UPAGE come from VMA's
+ * file. */
+size_t
+vma_page_read_bytes (const struct vma *vma, const void *upage) {
+	size_t skip = upage - vma->start;
+
+	if (skip >= vma->read_bytes) {
+		return 0;
+	}
+	return vma->read_bytes - skip < PGSIZE ? vma->read_bytes - skip : PGSIZE;
+}
+
+/* Fills PAGE, just given a frame, from the area AUX it lies in. */
+bool
+vma_load_page (struct page *page, void *aux) {
+	struct vma *vma = aux;
+	size_t read_bytes = vma_page_read_bytes (vma, page->va);
+	void *kva = page->frame->kva;
+
+	if (file_read_at (vma->file, kva, read_bytes,
+				vma_page_ofs (vma, page->va)) != (off_t) read_bytes) {
+		return false;
+	}
+	if (read_bytes > 0) {
+		vm_count_event (page->owner, VM_EV_PAGE_IN);
+	}
+	memset (kva + read_bytes, 0, PGSIZE - read_bytes);
+	return true;
+}
+
+/* Returns the first area of TREE whose end is above VA, or NULL. */
+static struct vma *
+first_ending_above (const struct vma_tree *tree, const void *va) {
+	struct vma *node = tree->root;
+	struct vma *best = NULL;
+
+	while (node != NULL) {
+		if (node->end > va) {
+			best = node;
+			node = node->left;
+		}
+		else {
+			node = node->right;
+		}
+	}
+	return best;
+}
+
+/* Returns the height of the subtree at NODE. */
+static int
+height (const struct vma *node) {
+	return node != NULL ? node->height : 0;
+}
+
+/* Recomputes the height of NODE from its children. */
+static void
+update_height (struct vma *node) {
+	int l = height (node->left), r = height (node->right);
+
+	node->height = (l > r ? l : r) + 1;
+}
+
+static struct vma *
+rotate_right (struct vma *node) {
+	struct vma *left = node->left;
+
+	node->left = left->right;
+	left->right = node;
+	update_height (node);
+	update_height (left);
+	return left;
+}
+
+static struct vma *
+rotate_left (struct vma *node) {
+	struct vma *right = node->right;
+
+	node->right = right->left;
+	right->left = node;
+	update_height (node);
+	update_height (right);
+	return right;
+}
+
+/* Restores the AVL balance at NODE, whose subtrees are balanced
+ * and differ in height by at most 2.  Returns the new root of the
+ * subtree. */
+static struct vma *
+rebalance (struct vma *node) {
+	int balance = height (node->left) - height (node->right);
+
+	update_height (node);
+	if (balance > 1) {
+		if (height (node->left->left) < height (node->left->right)) {
+			node->left = rotate_left (node->left);
+		}
+		return rotate_right (node);
+	}
+	if (balance < -1) {
+		if (height (node->right->right) < height (node->right->left)) {
+			node->right = rotate_right (node->right);
+		}
+		return rotate_left (node);
+	}
+	return node;
+}
+
+/* Inserts VMA into the subtree at NODE and returns its new root. */
+static struct vma *
+insert (struct vma *node, struct vma *vma) {
+	if (node == NULL) {
+		return vma;
+	}
+	if (vma->start < node->start) {
+		node->left = insert (node->left, vma);
+	}
+	else {
+		node->right = insert (node->right, vma);
+	}
+	return rebalance (node);
+}
+
+/* Unlinks the lowest area of the subtree at NODE, storing it in
+ * *MIN, and returns the new root. */
+static struct vma *
+erase_min (struct vma *node, struct vma **min) {
+	if (node->left == NULL) {
+		*min = node;
+		return node->right;
+	}
+	node->left = erase_min (node->left, min);
+	return rebalance (node);
+}
+
+/* Unlinks VMA from the subtree at NODE and returns its new root. */
+static struct vma *
+erase (struct vma *node, struct vma *vma) {
+	ASSERT (node != NULL);
+
+	if (vma->start < node->start) {
+		node->left = erase (node->left, vma);
+	}
+	else if (vma->start > node->start) {
+		node->right = erase (node->right, vma);
+	}
+	else {
+		struct vma *min, *right;
+
+		if (node->right == NULL) {
+			return node->left;
+		}
+		right = erase_min (node->right, &min);
+		min->right = right;
+		min->left = node->left;
+		node = min;
+	}
+	return rebalance (node);
+}
+
+static bool
+copy_subtree (struct vma_tree *dst, const struct vma *node) {
+	struct vma *copy;
+
+	if (node == NULL) {
+		return true;
+	}
+	if (!copy_subtree (dst, node->left)) {
+		return false;
+	}
+	copy = vma_create (dst, node->start, (node->end - node->start) / PGSIZE,
+			node->type, node->writable, node->file, node->ofs, node->read_bytes);
+	if (copy == NULL) {
+		return false;
+	}
+	copy->advice = node->advice;
+	return copy_subtree (dst, node->right);
+}
+
+static void
+destroy_subtree (struct vma *node) {
+	if (node == NULL) {
+		return;
+	}
+	destroy_subtree (node->left);
+	destroy_subtree (node->right);
+	file_close (node->file);
+	if (node->uffd != NULL) {
+		userfault_put (node->uffd);
+	}
+	free (node);
+}
@@ -0,0 +1,290 @@
+/* zswap.c: Compressed cache of swap slots, kept in RAM in front of the swap disk. */
+
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A page swapped out is compressed and kept in a pool of kernel
+ * memory instead of being written to its slot, which stays
+ * reserved for it.  Swapping it in again decompresses it, which is
+ * much cheaper than reading eight sectors by PIO.  When the pool
+ * is full, the oldest pages are written to their slots to make
+ * room.  Pages that do not shrink to ZSWAP_MAX_LEN go straight to
+ * disk.
+ *
+ * The pool is an array of ZSWAP_CHUNK-byte chunks, allocated in
+ * runs from a bitmap, like swap slots.  The caller serializes all
+ * calls; anon.c holds swap_lock. */
+#define ZSWAP_CHUNK 64
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4)
+
+size_t zswap_pool_pages;
+
+/* A compressed page. */
+struct zswap_entry {
+	struct list_elem elem;      /* Element in LRU, oldest first. */
+	size_t slot;                /* Swap slot the page belongs to. */
+	size_t chunk;               /* First chunk of its bytes in the pool. */
+	size_t len;                 /* Length of its bytes. */
+};
+
+static uint8_t *pool;
+static struct bitmap *chunk_map;
+static struct zswap_entry **entries;   /* Entry of each slot, or NULL. */
+static struct list lru;
+static void (*write_back_slot) (size_t slot, const void *kva);
+
+/* Scratch buffers, usable since calls are serialized. */
+static uint8_t *compressed;
+static uint8_t *bounce;
+
+static long long store_cnt;      /* # of pages compressed into the pool. */
+static long long reject_cnt;     /* # of pages that did not compress. */
+static long long load_cnt;       /* # of swap-ins served from the pool. */
+static long long write_back_cnt; /* # of pages written on to disk. */
+static size_t stored_bytes;      /* Bytes of the pages in the pool now. */
+
+static size_t lz_compress (const uint8_t *src, uint8_t *dst, size_t dst_max);
+static void lz_decompress (const uint8_t *src, size_t len, uint8_t *dst);
+static bool make_room (size_t chunk_cnt, size_t *chunk);
+
+/* Sets up the pool for a swap disk of SLOT_CNT slots.  WRITE_BACK
+ * writes a page to its slot on disk.  Does nothing if
+ * zswap_pool_pages is 0. */
+void
+zswap_init (size_t slot_cnt,
+		void (*write_back) (size_t slot, const void *kva)) {
+	if (zswap_pool_pages == 0) {
+		return;
+	}
+
+	pool = palloc_get_multiple (0, zswap_pool_pages);
+	chunk_map = bitmap_create (zswap_pool_pages * PGSIZE / ZSWAP_CHUNK);
+	entries = calloc (slot_cnt, sizeof *entries);
+	compressed = palloc_get_page (0);
+	bounce = palloc_get_page (0);
+	if (pool == NULL || chunk_map == NULL || entries == NULL
+			|| compressed == NULL || bounce == NULL) {
+		PANIC ("zswap_init: out of memory");
+	}
+	list_init (&lru);
+	write_back_slot = write_back;
+}
+
+/* Prints statistics of the pool, if there is one. */
+void
+zswap_print_stats (void) {
+	if (pool != NULL) {
+		printf ("Zswap: %lld pages stored, %lld did not compress, "
+				"%lld loaded, %lld written to disk, %zu entries in %zu bytes\n",
+				store_cnt, reject_cnt, load_cnt, write_back_cnt,
+				list_size (&lru), stored_bytes);
+	}
+}
+
+/* Compresses the page at KVA into the pool as the contents of
+ * SLOT, writing older pages to disk if it has to.  Returns false,
+ * storing nothing, if there is no pool or the page does not
+ * compress; the caller must then write it to disk itself. */
+bool
+zswap_store (size_t slot, const void *kva) {
+	struct zswap_entry *entry;
+	size_t len, chunk;
+
+	if (pool == NULL) {
+		return false;
+	}
+	ASSERT (entries[slot] == NULL);
+
+	len = lz_compress (kva, compressed, ZSWAP_MAX_LEN);
+	entry = len > 0 ? malloc (sizeof *entry) : NULL;
+	if (entry == NULL) {
+		reject_cnt++;
+		return false;
+	}
+	if (!make_room ((len + ZSWAP_CHUNK - 1) / ZSWAP_CHUNK, &chunk)) {
+		free (entry);
+		return false;
+	}
+
+	memcpy (pool + chunk * ZSWAP_CHUNK, compressed, len);
+	entry->slot = slot;
+	entry->chunk = chunk;
+	entry->len = len;
+	list_push_back (&lru, &entry->elem);
+	entries[slot] = entry;
+	stored_bytes += len;
+	store_cnt++;
+	return true;
+}
+
+/* Decompresses SLOT into KVA, if the pool holds it.  The pool
+ * keeps it until zswap_forget().  Returns true if it did. */
+bool
+zswap_load (size_t slot, void *kva) {
+	struct zswap_entry *entry = pool != NULL ? entries[slot] : NULL;
+
+	if (entry == NULL) {
+		return false;
+	}
+	lz_decompress (pool + entry->chunk * ZSWAP_CHUNK, entry->len, kva);
+	load_cnt++;
+	return true;
+}
+
+/* Returns true if the pool holds SLOT, whose slot on disk is then
+ * not up to date. */
+bool
+zswap_contains (size_t slot) {
+	return pool != NULL && entries[slot] != NULL;
+}
+
+/* Drops SLOT, which is no longer in use, from the pool. */
+void
+zswap_forget (size_t slot) {
+	struct zswap_entry *entry = pool != NULL ? entries[slot] : NULL;
+
+	if (entry == NULL) {
+		return;
+	}
+	list_remove (&entry->elem);
+	bitmap_set_multiple (chunk_map, entry->chunk,
+			(entry->len + ZSWAP_CHUNK - 1) / ZSWAP_CHUNK, false);
+	stored_bytes -= entry->len;
+	entries[slot] = NULL;
+	free (entry);
+}
+
+/* Finds CHUNK_CNT free chunks in a row, writing the oldest pages
+ * to disk until it does, and stores the first in *CHUNK.  Returns
+ * false if even an empty pool has no such run. */
+static bool
+make_room (size_t chunk_cnt, size_t *chunk) {
+	for (;;) {
+		struct zswap_entry *oldest;
+
+		*chunk = bitmap_scan_and_flip (chunk_map, 0, chunk_cnt, false);
+		if (*chunk != BITMAP_ERROR) {
+			return true;
+		}
+		if (list_empty (&lru)) {
+			return false;
+		}
+
+		oldest = list_entry (list_front (&lru), struct zswap_entry, elem);
+		lz_decompress (pool + oldest->chunk * ZSWAP_CHUNK, oldest->len, bounce);
+		write_back_slot (oldest->slot, bounce);
+		write_back_cnt++;
+		zswap_forget (oldest->slot);
+	}
+}
+
+/* LZ77 compression of a page, in the manner of LZRW1.  The output
+ * is a series of groups, each a flag byte followed by eight items.
+ * An item whose flag bit is clear is a literal byte.  One whose bit
+ * is set copies a match from earlier in the page: 12 bits of
+ * distance back, then 4 bits of length.  Lengths 3 to 17 are coded
+ * as 0 to 14; 15 means 18 plus the byte that follows. */
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (18 + 255)
+
+/* Last position, plus one, of each hashed 3-byte string. */
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+
+static unsigned
+lz_hash (const uint8_t *p) {
+	uint32_t v = p[0] | (p[1] << 8) | ((uint32_t) p[2] << 16);
+
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Compresses the page at SRC into DST.  Returns the length of the
+ * result, or 0 if it would not fit in DST_MAX bytes. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t dst_max) {
+	size_t in = 0, out = 0;
+
+	memset (lz_table, 0, sizeof lz_table);
+	while (in < PGSIZE) {
+		size_t flag_pos = out++;
+		uint8_t flags = 0;
+
+		for (int bit = 0; bit < 8 && in < PGSIZE; bit++) {
+			size_t len = 0, cand = 0;
+
+			if (out + 3 > dst_max) {
+				return 0;
+			}
+			if (in + LZ_MIN_MATCH <= PGSIZE) {
+				unsigned h = lz_hash (src + in);
+
+				cand = lz_table[h];
+				lz_table[h] = in + 1;
+				if (cand-- != 0) {
+					while (in + len < PGSIZE && len < LZ_MAX_MATCH
+							&& src[cand + len] == src[in + len]) {
+						len++;
+					}
+				}
+			}
+
+			if (len >= LZ_MIN_MATCH) {
+				size_t dist = in - cand;
+				size_t code = len < 18 ? len - LZ_MIN_MATCH : 15;
+
+				flags |= 1 << bit;
+				dst[out++] = dist >> 4;
+				dst[out++] = (dist & 15) << 4 | code;
+				if (code == 15) {
+					dst[out++] = len - 18;
+				}
+				in += len;
+			}
+			else {
+				dst[out++] = src[in++];
+			}
+		}
+		dst[flag_pos] = flags;
+	}
+	return out;
+}
+
+/* Decompresses the LEN bytes at SRC, made by lz_compress(), into
+ * the page at DST. */
+static void
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst) {
+	const uint8_t *end = src + len;
+	size_t out = 0;
+
+	while (src < end) {
+		uint8_t flags = *src++;
+
+		for (int bit = 0; bit < 8 && src < end; bit++) {
+			if (flags & (1 << bit)) {
+				size_t dist = (src[0] << 4) | (src[1] >> 4);
+				size_t len = (src[1] & 15) + LZ_MIN_MATCH;
+
+				src += 2;
+				if (len == 18) {
+					len += *src++;
+				}
+				ASSERT (dist <= out && out + len <= PGSIZE);
+				for (; len > 0; len--, out++) {
+					dst[out] = dst[out - dist];
+				}
+			}
+			else {
+				dst[out++] = *src++;
+			}
+		}
+	}
+	ASSERT (out == PGSIZE);
+}